@@ -0,0 +1,538 @@
+/*
+ * async_logger.cpp
+ * ----------------
+ * An asynchronous binary logger for hot paths.
+ *
+ * The demos in this repo print with std::endl and printf. std::endl flushes
+ * the stream, i.e. one write() system call per line; printf formats on the
+ * calling thread and takes the FILE lock. Logging every bad frame that way
+ * makes the frame-processing thread pay for formatting and I/O.
+ *
+ * Here the calling thread only copies the raw arguments:
+ *
+ *   LOG("bad frame %u: crc 0x%02x, expected 0x%02x", seq, got, want);
+ *     -> [site id | size][timestamp][seq][got][want]  into its own ring buffer
+ *
+ * and a background thread turns records back into text and writes them in
+ * large batches.
+ *
+ * 1. Call sites: LOG() registers each call site once (format string plus a
+ *    decoder instantiated for its argument types), so a record carries a
+ *    32-bit site id instead of the string. The format string is still
+ *    checked against the arguments at compile time, like printf.
+ * 2. Records: arithmetic arguments are stored raw; strings are copied with
+ *    their terminator (the caller's buffer may not outlive the call).
+ * 3. Per-thread rings: single-producer/single-consumer byte rings, so the
+ *    hot path has no lock and no shared cache line with other producers.
+ *    A full ring drops the record and counts it instead of blocking.
+ * 4. Background thread: drains the rings, formats with snprintf into a
+ *    64 KiB buffer, and write()s it when full or when the rings run dry.
+ * 5. Benchmark: std::endl, fprintf, and the logger, from a frame loop.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <tuple>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+// 2. Records
+// ----------
+// How each argument travels: C strings as NUL-terminated bytes, the rest raw.
+// std::string is not accepted: printf format checking cannot see through it,
+// so callers pass .c_str().
+template <typename T>
+using wire_t =
+    std::conditional_t<std::is_same_v<std::decay_t<T>, char*> || std::is_same_v<std::decay_t<T>, const char*>,
+                       const char*, std::decay_t<T>>;
+
+template <typename T>
+struct Wire {
+    static_assert(std::is_trivially_copyable_v<T>, "LOG() arguments must be C strings or trivially copyable");
+    static size_t size(const T&) { return sizeof(T); }
+    static void put(uint8_t*& p, const T& v) { std::memcpy(p, &v, sizeof(T)); p += sizeof(T); }
+    static T get(const uint8_t*& p) { T v; std::memcpy(&v, p, sizeof(T)); p += sizeof(T); return v; }
+};
+
+template <>
+struct Wire<const char*> {
+    static size_t size(const char* s) { return std::strlen(s) + 1; }
+    static void put(uint8_t*& p, const char* s) { size_t n = std::strlen(s) + 1; std::memcpy(p, s, n); p += n; }
+    static const char* get(const uint8_t*& p) {
+        const char* s = reinterpret_cast<const char*>(p); // points into the ring, valid while formatting
+        p += std::strlen(s) + 1;
+        return s;
+    }
+};
+
+struct RecordHeader {
+    uint32_t site;  // kPadding: skip to the end of the ring
+    uint32_t size;  // whole record, rounded up to 8 bytes
+    uint64_t timestamp_ns;
+};
+
+using Decoder = int (*)(const char* fmt, const uint8_t* args, char* out, size_t cap);
+
+// Reads the arguments back in order (braced initialization is evaluated
+// left to right) and formats them.
+template <typename... Ws>
+int decode_record(const char* fmt, const uint8_t* args, char* out, size_t cap) {
+    std::tuple<Ws...> values{Wire<Ws>::get(args)...};
+    return std::apply([&](auto... v) { return std::snprintf(out, cap, fmt, v...); }, values);
+}
+
+// 3. Per-thread ring
+// ------------------
+class LogRing {
+public:
+    static constexpr uint32_t kPadding = 0xFFFFFFFF;
+
+    explicit LogRing(size_t bytes) : mask_(bytes - 1), buf_(new uint8_t[bytes]) {}
+
+    // Producer: room for n bytes (a multiple of 8) in one piece, or nullptr.
+    uint8_t* reserve(size_t n) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        size_t pos = head & mask_;
+        size_t to_end = mask_ + 1 - pos;
+        size_t need = n <= to_end ? n : to_end + n; // wrap: pad the end of the ring
+        if (head + need - cached_tail_ > mask_ + 1) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head + need - cached_tail_ > mask_ + 1) return nullptr;
+        }
+        if (n > to_end) {
+            RecordHeader pad{kPadding, static_cast<uint32_t>(to_end), 0};
+            std::memcpy(buf_.get() + pos, &pad, std::min(to_end, sizeof(pad)));
+            pending_ = head + to_end + n;
+            return buf_.get();
+        }
+        pending_ = head + n;
+        return buf_.get() + pos;
+    }
+
+    void commit() { head_.store(pending_, std::memory_order_release); }
+
+    // Consumer: calls fn(header, args) for every committed record. Returns
+    // the number of records.
+    template <typename Fn>
+    size_t drain(Fn&& fn) {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        size_t n = 0;
+        while (tail != head) {
+            size_t pos = tail & mask_;
+            size_t to_end = mask_ + 1 - pos;
+            RecordHeader h;
+            if (to_end < sizeof(h)) { tail += to_end; continue; } // short padding at the very end
+            std::memcpy(&h, buf_.get() + pos, sizeof(h));
+            if (h.site != kPadding) {
+                fn(h, buf_.get() + pos + sizeof(h));
+                ++n;
+            }
+            tail += h.size;
+        }
+        tail_.store(tail, std::memory_order_release);
+        return n;
+    }
+
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> closed{false}; // owning thread exited
+    uint32_t thread_no = 0;
+
+private:
+    alignas(64) std::atomic<uint64_t> head_{0};
+    uint64_t cached_tail_ = 0;
+    uint64_t pending_ = 0;
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    size_t mask_;
+    std::unique_ptr<uint8_t[]> buf_;
+};
+
+// 4. The logger
+// -------------
+class AsyncLogger {
+public:
+    static constexpr size_t kRingBytes = 1 << 20;
+    static constexpr size_t kWriteBatch = 64 << 10;
+
+    // 'fd' is borrowed; the logger writes to it and never closes it.
+    void start(int fd) {
+        fd_ = fd;
+        stop_ = false;
+        running_ = true;
+        consumer_ = std::thread([this] { run(); });
+    }
+
+    // Writes out everything logged before the call and stops the background thread.
+    void stop() {
+        stop_ = true;
+        if (consumer_.joinable()) consumer_.join();
+        running_ = false;
+    }
+
+    // Returns once everything logged before the call is written. Returns at
+    // once if the logger is not running, since nothing would write it.
+    void flush() {
+        uint64_t ticket = flush_requested_.fetch_add(1) + 1;
+        while (running_.load(std::memory_order_acquire) && flush_done_.load(std::memory_order_acquire) < ticket)
+            std::this_thread::yield();
+    }
+
+    // Records lost to full rings so far (counted when the logger drains).
+    uint64_t dropped() const { return total_dropped_.load(); }
+
+    uint32_t register_site(const char* fmt, Decoder decoder) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sites_.push_back({fmt, decoder});
+        return static_cast<uint32_t>(sites_.size() - 1);
+    }
+
+    template <typename... Args>
+    void write(uint32_t site, const Args&... args) {
+        LogRing& ring = thread_ring();
+        size_t size = (sizeof(RecordHeader) + (Wire<wire_t<Args>>::size(args) + ... + 0) + 7) & ~size_t(7);
+        uint8_t* p = ring.reserve(size);
+        if (!p) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        RecordHeader h{site, static_cast<uint32_t>(size), now_ns()};
+        std::memcpy(p, &h, sizeof(h));
+        p += sizeof(h);
+        (Wire<wire_t<Args>>::put(p, args), ...);
+        ring.commit();
+    }
+
+private:
+    struct Site {
+        const char* fmt;
+        Decoder decoder;
+    };
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // The ring of the calling thread, created and registered on first use.
+    // At thread exit it is marked closed; the consumer drains and drops it.
+    LogRing& thread_ring() {
+        struct Holder {
+            std::shared_ptr<LogRing> ring;
+            ~Holder() { if (ring) ring->closed = true; }
+        };
+        thread_local Holder holder;
+        if (!holder.ring) {
+            holder.ring = std::make_shared<LogRing>(kRingBytes);
+            std::lock_guard<std::mutex> lock(mutex_);
+            holder.ring->thread_no = next_thread_no_++;
+            rings_.push_back(holder.ring);
+        }
+        return *holder.ring;
+    }
+
+    void run() {
+        for (;;) {
+            bool stopping = stop_.load(std::memory_order_acquire);
+            uint64_t ticket = flush_requested_.load(std::memory_order_acquire);
+            std::vector<std::shared_ptr<LogRing>> rings;
+            std::vector<Site> sites;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                rings = rings_;
+                sites = sites_;
+            }
+            size_t records = 0;
+            for (auto& ring : rings) records += drain_ring(*ring, sites);
+            if (out_.size() >= kWriteBatch) write_out();
+            // One full pass after reading the ticket covers everything logged
+            // before flush() or stop() was called, even if threads keep logging.
+            bool flushing = ticket != flush_done_.load(std::memory_order_relaxed);
+            if (records == 0 || flushing || stopping) {
+                // Retire the rings of threads that have exited. A thread may
+                // have logged after the drain above and before setting
+                // 'closed', so each retired ring is drained once more.
+                std::vector<std::shared_ptr<LogRing>> retired;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    auto live = std::stable_partition(rings_.begin(), rings_.end(),
+                                                      [](const std::shared_ptr<LogRing>& r) { return !r->closed; });
+                    retired.assign(live, rings_.end());
+                    rings_.erase(live, rings_.end());
+                    sites = sites_;
+                }
+                for (auto& ring : retired) drain_ring(*ring, sites);
+                write_out();
+                flush_done_.store(ticket, std::memory_order_release);
+                if (stopping) return;
+            }
+            if (records == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    // Formats everything in 'ring' into out_ and reports records it dropped.
+    // 'sites' is refreshed when a record names a site registered after it
+    // was copied (the site was registered before its record was committed).
+    size_t drain_ring(LogRing& ring, std::vector<Site>& sites) {
+        uint32_t thread_no = ring.thread_no;
+        size_t records = ring.drain([&](const RecordHeader& h, const uint8_t* args) {
+            if (h.site >= sites.size()) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                sites = sites_;
+            }
+            format(sites[h.site], h, thread_no, args);
+        });
+        if (uint64_t lost = ring.dropped.exchange(0)) {
+            total_dropped_ += lost;
+            char line[96];
+            int n = std::snprintf(line, sizeof(line), "[logger] thread %u: %llu records dropped, ring full\n",
+                                  thread_no, static_cast<unsigned long long>(lost));
+            out_.append(line, n);
+        }
+        return records;
+    }
+
+    void format(const Site& site, const RecordHeader& h, uint32_t thread_no, const uint8_t* args) {
+        char line[512];
+        uint64_t us = (h.timestamp_ns - start_ns_) / 1000;
+        int n = std::snprintf(line, sizeof(line), "%8llu.%06llu [%u] ", static_cast<unsigned long long>(us / 1000000),
+                              static_cast<unsigned long long>(us % 1000000), thread_no);
+        int m = site.decoder(site.fmt, args, line + n, sizeof(line) - n - 1);
+        n = std::min<int>(n + std::max(m, 0), sizeof(line) - 2);
+        line[n++] = '\n';
+        out_.append(line, n);
+    }
+
+    void write_out() {
+        size_t done = 0;
+        while (done < out_.size()) {
+            ssize_t w = ::write(fd_, out_.data() + done, out_.size() - done);
+            if (w <= 0) break;
+            done += static_cast<size_t>(w);
+        }
+        out_.clear();
+    }
+
+    std::mutex mutex_; // registration only, never on the logging path
+    std::vector<Site> sites_;
+    std::vector<std::shared_ptr<LogRing>> rings_;
+    uint32_t next_thread_no_ = 0;
+    std::thread consumer_;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> flush_requested_{0}, flush_done_{0};
+    std::atomic<uint64_t> total_dropped_{0};
+    std::string out_;
+    int fd_ = -1;
+    uint64_t start_ns_ = now_ns();  // timestamps are printed relative to this
+};
+
+AsyncLogger g_logger;
+
+// 1. Call sites
+// -------------
+// Each LOG() expands to a distinct lambda type, so log_at<Tag, ...> - and its
+// static site id - is instantiated once per call site.
+template <typename Tag, typename... Args>
+void log_at(Tag tag, const Args&... args) {
+    static const uint32_t site = g_logger.register_site(tag(), &decode_record<wire_t<Args>...>);
+    g_logger.write(site, args...);
+}
+
+// Never called: gives LOG() the compiler's printf format checking.
+inline void check_format(const char*, ...) __attribute__((format(printf, 1, 2)));
+inline void check_format(const char*, ...) {}
+
+#define LOG(fmt, ...)                                   \
+    do {                                                \
+        if (false) check_format(fmt, ##__VA_ARGS__);    \
+        log_at([] { return fmt; }, ##__VA_ARGS__);      \
+    } while (0)
+
+// 5. Benchmark
+// ------------
+struct Crc8Table {
+    uint8_t t[256];
+    Crc8Table() {
+        for (int n = 0; n < 256; ++n) {
+            uint8_t c = static_cast<uint8_t>(n);
+            for (int i = 0; i < 8; ++i) c = (c & 0x80) ? (c << 1) ^ 0x07 : c << 1;
+            t[n] = c;
+        }
+    }
+};
+static const Crc8Table kCrc8;
+
+uint8_t crc8(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; ++i) crc = kCrc8.t[crc ^ data[i]];
+    return crc;
+}
+
+uint64_t next_random(uint64_t& x) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    return x;
+}
+
+template <typename Callback>
+double time_ms(Callback cb) {
+    auto t = std::chrono::steady_clock::now();
+    cb();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+// CPU time of the calling thread only (user + system), so the logger
+// thread's work is not charged to the frame thread when they share a core.
+template <typename Callback>
+double thread_cpu_ms(Callback cb) {
+    auto now = [] {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+    };
+    double t = now();
+    cb();
+    return now() - t;
+}
+
+// Checks 'frames' 64-byte frames, a quarter of them corrupted, and reports
+// each bad one through 'report'. Returns the number of bad frames.
+template <typename Report>
+size_t process_frames(size_t frames, Report&& report) {
+    uint8_t frame[64];
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    size_t bad = 0;
+    for (uint32_t seq = 0; seq < frames; ++seq) {
+        for (size_t i = 0; i < sizeof(frame); i += 8) {
+            uint64_t r = next_random(x);
+            std::memcpy(frame + i, &r, 8);
+        }
+        uint8_t want = crc8(frame, sizeof(frame) - 1);
+        uint8_t got = seq % 4 == 0 ? static_cast<uint8_t>(want ^ 0x5A) : want;
+        if (got != want) {
+            ++bad;
+            report(seq, got, want);
+        }
+    }
+    return bad;
+}
+
+size_t count_lines(const char* path) {
+    std::ifstream in(path);
+    return static_cast<size_t>(std::count(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>(), '\n'));
+}
+
+int main() {
+    const size_t frames = 2000000;
+    const char* endl_path = "/tmp/async_logger_endl.log";
+    const char* printf_path = "/tmp/async_logger_printf.log";
+    const char* async_path = "/tmp/async_logger_async.log";
+
+    std::cout << "[1] " << frames << " frames, every 4th bad and logged; CPU time of the frame thread" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    size_t bad = 0;
+    double base = thread_cpu_ms([&] { bad = process_frames(frames, [](uint32_t, uint8_t, uint8_t) {}); });
+    std::cout << "  no logging:   " << std::setw(7) << base << " ms (" << bad << " bad frames)" << std::endl;
+    auto report = [&](const char* label, double ms, double wall_ms, const std::string& extra) {
+        std::cout << "  " << std::left << std::setw(14) << label << std::right << std::setw(7) << ms << " ms, "
+                  << std::setw(6) << (ms - base) * 1e6 / bad << " ns per record (wall " << wall_ms << " ms" << extra
+                  << ")" << std::endl;
+    };
+    {
+        std::ofstream out(endl_path);
+        double cpu = 0;
+        double wall = time_ms([&] {
+            cpu = thread_cpu_ms([&] {
+                process_frames(frames, [&](uint32_t seq, uint8_t got, uint8_t want) {
+                    out << "bad frame " << seq << ": crc 0x" << std::hex << int(got) << ", expected 0x" << int(want)
+                        << std::dec << std::endl;
+                });
+            });
+        });
+        report("std::endl:", cpu, wall, "");
+    }
+    {
+        FILE* out = std::fopen(printf_path, "w");
+        double cpu = 0;
+        double wall = time_ms([&] {
+            cpu = thread_cpu_ms([&] {
+                process_frames(frames, [&](uint32_t seq, uint8_t got, uint8_t want) {
+                    std::fprintf(out, "bad frame %u: crc 0x%02x, expected 0x%02x\n", seq, got, want);
+                });
+            });
+            std::fclose(out);
+        });
+        report("fprintf:", cpu, wall, "");
+    }
+    size_t dropped = 0;
+    {
+        // The call alone: the ring fills while the logger thread is not yet running.
+        const uint32_t calls = 20000;
+        double alone = thread_cpu_ms([&] {
+            for (uint32_t i = 0; i < calls; ++i) LOG("warm-up record %u of %u", i, calls);
+        });
+        std::cout << "  LOG() alone:  " << std::setw(7) << alone << " ms, " << std::setw(6) << alone * 1e6 / calls
+                  << " ns per record (" << calls << " records, logger thread not started)" << std::endl;
+        int fd = ::open(async_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        g_logger.start(fd);
+        LOG("frame check started, %zu frames", frames);
+        double cpu = 0;
+        double wall = time_ms([&] {
+            cpu = thread_cpu_ms([&] {
+                process_frames(frames, [](uint32_t seq, uint8_t got, uint8_t want) {
+                    LOG("bad frame %u: crc 0x%02x, expected 0x%02x", seq, got, want);
+                });
+            });
+            g_logger.flush();
+        });
+        report("async logger:", cpu, wall, " until written");
+
+        // [2] Several producer threads, each with its own ring.
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back([t] {
+                for (int i = 0; i < 50000; ++i) LOG("worker %d: item %d, queue %s", t, i, i % 2 ? "rx" : "tx");
+            });
+        for (auto& th : threads) th.join();
+        g_logger.stop();
+        dropped = g_logger.dropped();
+        ::close(fd);
+    }
+    size_t async_lines = count_lines(async_path);
+    std::cout << "[2] Lines written: endl " << count_lines(endl_path) << ", fprintf " << count_lines(printf_path)
+              << ", async " << async_lines << std::endl;
+    size_t records = 20000 + 1 + bad + 200000;
+    std::cout << "  async: 20000 + 1 + " << bad << " + 4 threads x 50000 = " << records << " records, " << dropped
+              << " dropped on full rings (reported in " << async_lines - (records - dropped) << " lines)" << std::endl;
+    std::ifstream in(async_path);
+    std::string line;
+    for (int i = 0; i < 3 && std::getline(in, line); ++i) std::cout << "  " << line << std::endl;
+
+    std::remove(endl_path);
+    std::remove(printf_path);
+    std::remove(async_path);
+    /*
+     * The frame thread's cost per record is a timestamp and a few stores into
+     * memory it owns ("LOG() alone"). Formatting and write() still happen, on
+     * the logger thread; on a machine with spare cores that is off the
+     * critical path. With a single core the two threads share it, and the
+     * frame thread also pays for the context switches and the cache lines the
+     * logger evicts, which is most of the per-record cost in the frame loop.
+     * Lines from different threads are written per ring, so they are ordered
+     * by time within each thread only.
+     */
+    return 0;
+}
@@ -0,0 +1,280 @@
+/*
+ * atomic_bitset.cpp
+ * -----------------
+ * A lock-free bitset for flags that many threads set and test concurrently.
+ *
+ * In bitwise_and.cpp sections 7 and 13 the flags live in one plain integer:
+ *     flags |= FLAG_A;  if (flags & FLAG_B) ...
+ * With several threads that read-modify-write is a data race: two threads
+ * setting different bits of the same word can lose one of the updates.
+ * std::atomic<uint64_t>::fetch_or / fetch_and perform the same OR/AND as one
+ * indivisible instruction (lock or / lock and on x86), and return the previous
+ * value so "was it already set?" comes for free.
+ *
+ * 1. set / clear / test / test_and_set on single bits.
+ * 2. find_first_set / find_first_zero using count-trailing-zeros on whole words.
+ * 3. claim() / release(): lock-free slot allocation (find a zero bit, then
+ *    test_and_set it; retry if another thread won the race).
+ * 4. Layout: with a packed layout, flags of different threads often share a
+ *    64-byte cache line, and every atomic update bounces that line between
+ *    cores ("false sharing"). The striped layout spreads consecutive 64-bit
+ *    words across different cache lines, round-robin. The line count is
+ *    rounded up to a power of two so the mapping is a mask and a shift.
+ * 5. Contention benchmarks for both layouts against a mutex-protected bitset.
+ */
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+enum class BitsetLayout { Packed, Striped };
+
+// 1-3. The bitset
+// ---------------
+template <BitsetLayout Layout>
+class AtomicBitset {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+    static const size_t kWordsPerLine = 64 / sizeof(uint64_t);
+
+    explicit AtomicBitset(size_t bits)
+        : bits_(bits),
+          words_((bits + 63) / 64),
+          lines_(round_up_pow2((words_ + kWordsPerLine - 1) / kWordsPerLine)),
+          line_shift_(static_cast<unsigned>(__builtin_ctzll(lines_))),
+          storage_(new std::atomic<uint64_t>[lines_ * kWordsPerLine + kWordsPerLine]) {
+        // Align the array to a cache line so "one line" really means one line.
+        uintptr_t p = reinterpret_cast<uintptr_t>(storage_.get());
+        data_ = reinterpret_cast<std::atomic<uint64_t>*>((p + 63) & ~uintptr_t(63));
+        for (size_t i = 0; i < lines_ * kWordsPerLine; ++i) data_[i].store(0, std::memory_order_relaxed);
+    }
+
+    size_t size() const { return bits_; }
+
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    // Returns the previous value of the bit.
+    bool set(size_t i) {
+        uint64_t mask = uint64_t(1) << (i & 63);
+        return word(i >> 6).fetch_or(mask, std::memory_order_acq_rel) & mask;
+    }
+
+    bool clear(size_t i) {
+        uint64_t mask = uint64_t(1) << (i & 63);
+        return word(i >> 6).fetch_and(~mask, std::memory_order_acq_rel) & mask;
+    }
+
+    bool test(size_t i) const {
+        return word(i >> 6).load(std::memory_order_acquire) & (uint64_t(1) << (i & 63));
+    }
+
+    // True if this call changed the bit from 0 to 1 (i.e. the caller "won" it).
+    bool test_and_set(size_t i) { return !set(i); }
+
+    // First set bit at or after 'from', or npos. The result is a snapshot: other
+    // threads may change the bit right after it has been read.
+    size_t find_first_set(size_t from = 0) const { return find(from, false); }
+
+    // First zero bit at or after 'from', or npos.
+    size_t find_first_zero(size_t from = 0) const { return find(from, true); }
+
+    // Lock-free slot allocation: atomically claims a zero bit and returns its
+    // index, or npos when the bitset is full. 'hint' spreads threads apart.
+    size_t claim(size_t hint = 0) {
+        if (bits_ == 0) return npos;
+        size_t start = hint % bits_;
+        for (size_t from : {start, size_t(0)}) {
+            for (size_t i = find_first_zero(from); i != npos; i = find_first_zero(i + 1))
+                if (test_and_set(i)) return i; // otherwise another thread won this bit
+        }
+        return npos;
+    }
+
+    void release(size_t i) { clear(i); }
+
+private:
+    // Logical word w -> physical slot. Striped: word w lives in line (w % lines),
+    // so words w and w+1 never share a line when there is more than one line.
+    std::atomic<uint64_t>& word(size_t w) const {
+        if (Layout == BitsetLayout::Striped)
+            return data_[(w & (lines_ - 1)) * kWordsPerLine + (w >> line_shift_)];
+        return data_[w];
+    }
+
+    size_t find(size_t from, bool zeros) const {
+        if (from >= bits_) return npos;
+        size_t w = from >> 6;
+        uint64_t v = word(w).load(std::memory_order_acquire);
+        if (zeros) v = ~v;
+        v &= ~uint64_t(0) << (from & 63); // ignore bits before 'from'
+        for (;;) {
+            if (v) {
+                size_t i = (w << 6) + static_cast<size_t>(__builtin_ctzll(v));
+                return i < bits_ ? i : npos;
+            }
+            if (++w == words_) return npos;
+            v = word(w).load(std::memory_order_acquire);
+            if (zeros) v = ~v;
+        }
+    }
+
+    size_t bits_;
+    size_t words_;
+    size_t lines_;
+    unsigned line_shift_;
+    std::unique_ptr<std::atomic<uint64_t>[]> storage_;
+    std::atomic<uint64_t>* data_;
+};
+
+// Baseline for the benchmarks: the same operations behind one mutex.
+class MutexBitset {
+public:
+    explicit MutexBitset(size_t bits) : bits_(bits), words_((bits + 63) / 64, 0) {}
+
+    bool set(size_t i) {
+        std::lock_guard<std::mutex> lock(m_);
+        bool old = words_[i >> 6] >> (i & 63) & 1;
+        words_[i >> 6] |= uint64_t(1) << (i & 63);
+        return old;
+    }
+
+    bool clear(size_t i) {
+        std::lock_guard<std::mutex> lock(m_);
+        bool old = words_[i >> 6] >> (i & 63) & 1;
+        words_[i >> 6] &= ~(uint64_t(1) << (i & 63));
+        return old;
+    }
+
+    size_t claim(size_t) {
+        std::lock_guard<std::mutex> lock(m_);
+        for (size_t w = 0; w < words_.size(); ++w) {
+            if (~words_[w] == 0) continue;
+            size_t i = (w << 6) + static_cast<size_t>(__builtin_ctzll(~words_[w]));
+            if (i >= bits_) break;
+            words_[w] |= uint64_t(1) << (i & 63);
+            return i;
+        }
+        return static_cast<size_t>(-1);
+    }
+
+    void release(size_t i) { clear(i); }
+
+private:
+    std::mutex m_;
+    size_t bits_;
+    std::vector<uint64_t> words_;
+};
+
+// 5. Benchmarks
+// -------------
+// Runs 'body(thread_index)' on 'threads' threads and returns million ops/second.
+template <typename Body>
+double run_threads(int threads, long ops_per_thread, Body body) {
+    std::atomic<int> ready{0};
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            ready.fetch_add(1);
+            while (ready.load() < threads) std::this_thread::yield(); // start together
+            body(t);
+        });
+    }
+    for (auto& w : workers) w.join();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return threads * ops_per_thread / s / 1e6;
+}
+
+// Each thread toggles its own flag, but the flags are in neighbouring words:
+// thread t uses bit t * 64 (word t). Packed puts all those words in one cache line.
+template <typename Bitset>
+double bench_private_flags(int threads, long ops) {
+    Bitset bs(threads * 64 * 64);
+    return run_threads(threads, ops, [&](int t) {
+        size_t bit = static_cast<size_t>(t) * 64;
+        for (long i = 0; i < ops / 2; ++i) {
+            bs.set(bit);
+            bs.clear(bit);
+        }
+    });
+}
+
+// Every thread repeatedly claims and releases slots from a shared pool.
+template <typename Bitset>
+double bench_claim_release(int threads, long ops) {
+    Bitset bs(4096);
+    return run_threads(threads, ops, [&](int t) {
+        for (long i = 0; i < ops / 2; ++i) {
+            size_t slot = bs.claim(static_cast<size_t>(t) * 512);
+            if (slot != static_cast<size_t>(-1)) bs.release(slot);
+        }
+    });
+}
+
+int main() {
+    // Connection state flags, as in bitwise_and.cpp section 7, but one byte of
+    // flags per connection inside a shared atomic bitset.
+    const size_t STATE_ALIVE = 0, STATE_VISIBLE = 1, STATE_INVINCIBLE = 2, FLAGS_PER_CONN = 8;
+    AtomicBitset<BitsetLayout::Striped> conn_flags(1024 * FLAGS_PER_CONN);
+    size_t conn = 42;
+    conn_flags.set(conn * FLAGS_PER_CONN + STATE_ALIVE);
+    conn_flags.set(conn * FLAGS_PER_CONN + STATE_VISIBLE);
+    std::cout << "[1] Connection " << conn << " flags" << std::endl;
+    std::cout << "Alive: " << conn_flags.test(conn * FLAGS_PER_CONN + STATE_ALIVE)
+              << ", Visible: " << conn_flags.test(conn * FLAGS_PER_CONN + STATE_VISIBLE)
+              << ", Invincible: " << conn_flags.test(conn * FLAGS_PER_CONN + STATE_INVINCIBLE) << std::endl;
+    std::cout << "test_and_set(VISIBLE) won: " << conn_flags.test_and_set(conn * FLAGS_PER_CONN + STATE_VISIBLE)
+              << " (already set)" << std::endl;
+    std::cout << "First set bit: " << conn_flags.find_first_set() << ", first zero bit: "
+              << conn_flags.find_first_zero() << std::endl << std::endl;
+
+    // Correctness under contention: N threads claim slots until the pool is empty;
+    // every slot must be handed out exactly once.
+    const int threads = std::max(4u, std::thread::hardware_concurrency());
+    const size_t slots = 100000;
+    AtomicBitset<BitsetLayout::Striped> pool(slots);
+    std::vector<std::vector<size_t>> claimed(threads);
+    run_threads(threads, 1, [&](int t) {
+        for (;;) {
+            size_t s = pool.claim(static_cast<size_t>(t) * (slots / threads));
+            if (s == pool.npos) break;
+            claimed[t].push_back(s);
+        }
+    });
+    std::vector<int> owner_count(slots, 0);
+    size_t total = 0;
+    for (auto& v : claimed)
+        for (size_t s : v) { ++owner_count[s]; ++total; }
+    bool exact = total == slots;
+    for (int c : owner_count) exact &= (c == 1);
+    std::cout << "[2] " << threads << " threads claimed " << total << " of " << slots
+              << " slots: " << (exact ? "each slot exactly once" : "DUPLICATE OR MISSING SLOTS") << std::endl << std::endl;
+
+    std::cout << "[3] Contention benchmarks (" << threads << " threads, Mops/s)" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    const long ops = 2000000;
+    std::cout << "  private flags, packed:     " << bench_private_flags<AtomicBitset<BitsetLayout::Packed>>(threads, ops) << std::endl;
+    std::cout << "  private flags, striped:    " << bench_private_flags<AtomicBitset<BitsetLayout::Striped>>(threads, ops) << std::endl;
+    std::cout << "  private flags, mutex:      " << bench_private_flags<MutexBitset>(threads, ops) << std::endl;
+    std::cout << "  claim/release, packed:     " << bench_claim_release<AtomicBitset<BitsetLayout::Packed>>(threads, ops) << std::endl;
+    std::cout << "  claim/release, striped:    " << bench_claim_release<AtomicBitset<BitsetLayout::Striped>>(threads, ops) << std::endl;
+    std::cout << "  claim/release, mutex:      " << bench_claim_release<MutexBitset>(threads, ops) << std::endl;
+
+    /*
+     * On a multi-core machine the striped layout avoids the cache-line
+     * ping-pong of the packed layout for per-thread flags, and both lock-free
+     * variants scale better than the mutex under contention.
+     */
+    return 0;
+}
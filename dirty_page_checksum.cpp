@@ -0,0 +1,380 @@
+/*
+ * dirty_page_checksum.cpp
+ * -----------------------
+ * Incremental CRC-32 of a large memory region that only re-reads the pages
+ * written since the previous check.
+ *
+ * A full checksum of a multi-GB region costs seconds, even though between two
+ * checks usually only a few pages have changed. Instead we keep one CRC-32 per
+ * page and:
+ * 1. Ask a dirty-page tracker which pages were written since the last check.
+ * 2. Recompute the CRC of only those pages.
+ * 3. Combine all per-page CRCs into the CRC of the whole region.
+ *
+ * Two trackers are provided (Linux only):
+ * - SoftDirtyTracker: the kernel's soft-dirty bits. Writing "4" to
+ *   /proc/self/clear_refs clears them, and bit 55 of each /proc/self/pagemap
+ *   entry is set again once the page is written. Requires CONFIG_MEM_SOFT_DIRTY.
+ * - WriteProtectTracker: the portable fallback. The region is mprotect()ed
+ *   read-only; the first write to a page raises SIGSEGV, the handler records the
+ *   page as dirty and makes it writable again. Each page therefore costs one
+ *   fault per check interval, so overhead follows the write rate.
+ *
+ * Combining works because CRC-32 is linear: crc(A + B) = shift(crc(A), |B|) ^ crc(B),
+ * where shift multiplies by x^(8*|B|) mod P (the same math as zlib's crc32_combine).
+ * All pages have the same length, so that shift is a fixed linear map which is
+ * tabulated once; folding a page CRC into the running total costs 4 table lookups.
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// 1. CRC-32 (IEEE, reflected polynomial 0xEDB88320)
+// -------------------------------------------------
+static const uint32_t kCrcPoly = 0xEDB88320u;
+static uint32_t crc32_table[256];
+
+void init_crc32_table() {
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? (c >> 1) ^ kCrcPoly : c >> 1;
+        crc32_table[n] = c;
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i)
+        crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// 2. CRC combination math
+// -----------------------
+// Polynomials are stored reflected: bit 31 is x^0, bit 30 is x^1, ...
+// a * b mod P
+uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = 1u << 31, p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ kCrcPoly : b >> 1;
+    }
+    return p;
+}
+
+// x^(8 * bytes) mod P by repeated squaring.
+uint32_t x8nmodp(uint64_t bytes) {
+    uint32_t result = 1u << 31;  // x^0
+    uint32_t square = 1u << 23;  // x^8
+    while (bytes) {
+        if (bytes & 1) result = multmodp(square, result);
+        square = multmodp(square, square);
+        bytes >>= 1;
+    }
+    return result;
+}
+
+// Multiplying by a fixed x^(8n) is linear in the CRC, so it can be split per
+// input byte: shift(c) = T[0][c & 0xFF] ^ T[1][(c >> 8) & 0xFF] ^ ...
+struct CrcShifter {
+    uint32_t table[4][256];
+
+    explicit CrcShifter(uint64_t bytes) {
+        uint32_t op = x8nmodp(bytes);
+        for (int k = 0; k < 4; ++k)
+            for (uint32_t b = 0; b < 256; ++b)
+                table[k][b] = multmodp(op, b << (8 * k));
+    }
+
+    uint32_t shift(uint32_t c) const {
+        return table[0][c & 0xFF] ^ table[1][(c >> 8) & 0xFF] ^
+               table[2][(c >> 16) & 0xFF] ^ table[3][c >> 24];
+    }
+};
+
+// 3. Dirty page trackers
+// ----------------------
+// arm() starts tracking. collect() returns the pages written since the last
+// arm() or collect() and starts the next interval in the same call, so the
+// caller never leaves a gap between the two. Writers should be quiescent while
+// the returned pages are read: a store landing after its page was hashed is not
+// reported again.
+class DirtyTracker {
+public:
+    virtual ~DirtyTracker() = default;
+    virtual const char* name() const = 0;
+    virtual void arm() = 0;
+    virtual std::vector<size_t> collect() = 0;
+};
+
+class SoftDirtyTracker : public DirtyTracker {
+public:
+    SoftDirtyTracker(uint8_t* base, size_t pages, size_t page_size)
+        : base_(base), pages_(pages), page_size_(page_size) {
+        pagemap_fd_ = open("/proc/self/pagemap", O_RDONLY);
+        clear_refs_fd_ = open("/proc/self/clear_refs", O_WRONLY);
+    }
+
+    ~SoftDirtyTracker() override {
+        if (pagemap_fd_ >= 0) close(pagemap_fd_);
+        if (clear_refs_fd_ >= 0) close(clear_refs_fd_);
+    }
+
+    // The files exist even on kernels without soft-dirty support, so probe by
+    // clearing, writing one page and checking that its bit comes back.
+    bool supported() {
+        if (pagemap_fd_ < 0 || clear_refs_fd_ < 0) return false;
+        volatile uint8_t* probe = base_;
+        uint8_t saved = *probe;
+        arm();
+        *probe = saved;
+        return page_dirty(0);
+    }
+
+    const char* name() const override { return "soft-dirty (/proc/self/pagemap)"; }
+
+    // Note: this clears the soft-dirty bits of the whole process, not only of this region.
+    void arm() override {
+        if (write(clear_refs_fd_, "4", 1) != 1)
+            std::cout << "ERROR: cannot write /proc/self/clear_refs" << std::endl;
+    }
+
+    // Reading pagemap and clearing the bits are two system calls, so a write
+    // between them is lost; this tracker requires quiescent writers.
+    std::vector<size_t> collect() override {
+        std::vector<size_t> dirty;
+        std::vector<uint64_t> entries(4096);
+        for (size_t first = 0; first < pages_; first += entries.size()) {
+            size_t count = std::min(entries.size(), pages_ - first);
+            read_entries(first, entries.data(), count);
+            for (size_t i = 0; i < count; ++i)
+                if (entries[i] & (uint64_t(1) << 55)) dirty.push_back(first + i);
+        }
+        arm();
+        return dirty;
+    }
+
+private:
+    void read_entries(size_t first_page, uint64_t* out, size_t count) {
+        uintptr_t vpage = reinterpret_cast<uintptr_t>(base_) / page_size_ + first_page;
+        ssize_t want = static_cast<ssize_t>(count * sizeof(uint64_t));
+        if (pread(pagemap_fd_, out, want, static_cast<off_t>(vpage * sizeof(uint64_t))) != want)
+            std::memset(out, 0xFF, count * sizeof(uint64_t)); // unreadable: treat as dirty
+    }
+
+    bool page_dirty(size_t page) {
+        uint64_t entry;
+        read_entries(page, &entry, 1);
+        return entry & (uint64_t(1) << 55);
+    }
+
+    uint8_t* base_;
+    size_t pages_;
+    size_t page_size_;
+    int pagemap_fd_ = -1;
+    int clear_refs_fd_ = -1;
+};
+
+// Only one region can be write-protect tracked at a time (one SIGSEGV handler).
+class WriteProtectTracker : public DirtyTracker {
+public:
+    WriteProtectTracker(uint8_t* base, size_t pages, size_t page_size)
+        : base_(base), pages_(pages), page_size_(page_size), dirty_(pages) {
+        active_ = this;
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &WriteProtectTracker::on_fault;
+        sa.sa_flags = SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGSEGV, &sa, &previous_);
+    }
+
+    ~WriteProtectTracker() override {
+        mprotect(base_, pages_ * page_size_, PROT_READ | PROT_WRITE);
+        sigaction(SIGSEGV, &previous_, nullptr);
+        active_ = nullptr;
+    }
+
+    const char* name() const override { return "write-protect (mprotect + SIGSEGV)"; }
+
+    void arm() override {
+        for (auto& d : dirty_) d.store(0, std::memory_order_relaxed);
+        mprotect(base_, pages_ * page_size_, PROT_READ);
+    }
+
+    // Protect first, then take the flags: a write after the mprotect() faults and
+    // either sets its flag before the exchange (reported now) or after it
+    // (reported by the next collect()).
+    std::vector<size_t> collect() override {
+        mprotect(base_, pages_ * page_size_, PROT_READ);
+        std::vector<size_t> dirty;
+        for (size_t i = 0; i < pages_; ++i)
+            if (dirty_[i].exchange(0, std::memory_order_acq_rel)) dirty.push_back(i);
+        return dirty;
+    }
+
+private:
+    // Async-signal-safe: only an atomic store and mprotect().
+    static void on_fault(int sig, siginfo_t* info, void* context) {
+        WriteProtectTracker* self = active_;
+        uint8_t* addr = static_cast<uint8_t*>(info->si_addr);
+        if (self && addr >= self->base_ && addr < self->base_ + self->pages_ * self->page_size_) {
+            size_t page = static_cast<size_t>(addr - self->base_) / self->page_size_;
+            self->dirty_[page].store(1, std::memory_order_relaxed);
+            mprotect(self->base_ + page * self->page_size_, self->page_size_, PROT_READ | PROT_WRITE);
+            return; // the faulting write is retried and now succeeds
+        }
+        // Not ours: hand it to whoever handled SIGSEGV before us.
+        if (self && (self->previous_.sa_flags & SA_SIGINFO)) {
+            self->previous_.sa_sigaction(sig, info, context);
+        } else if (self && self->previous_.sa_handler != SIG_DFL && self->previous_.sa_handler != SIG_IGN) {
+            self->previous_.sa_handler(sig);
+        } else {
+            signal(sig, SIG_DFL); // a genuine crash: re-raised when the handler returns
+            raise(sig);
+        }
+    }
+
+    static WriteProtectTracker* active_;
+    uint8_t* base_;
+    size_t pages_;
+    size_t page_size_;
+    std::vector<std::atomic<uint8_t>> dirty_;
+    struct sigaction previous_{}; // zeroed: SIG_DFL until the constructor saves the real one
+};
+
+WriteProtectTracker* WriteProtectTracker::active_ = nullptr;
+
+// 4. The region checksummer
+// -------------------------
+class RegionChecksummer {
+public:
+    explicit RegionChecksummer(size_t bytes) {
+        page_size_ = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        pages_ = (bytes + page_size_ - 1) / page_size_;
+        void* p = mmap(nullptr, pages_ * page_size_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        base_ = (p == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(p);
+        page_crcs_.assign(pages_, 0);
+        shifter_.reset(new CrcShifter(page_size_));
+
+        // Prefer the kernel's soft-dirty bits; fall back to write protection.
+        if (base_) {
+            std::unique_ptr<SoftDirtyTracker> soft(new SoftDirtyTracker(base_, pages_, page_size_));
+            if (soft->supported())
+                tracker_ = std::move(soft);
+            else
+                tracker_.reset(new WriteProtectTracker(base_, pages_, page_size_));
+        }
+    }
+
+    ~RegionChecksummer() {
+        tracker_.reset();
+        if (base_) munmap(base_, pages_ * page_size_);
+    }
+
+    uint8_t* data() { return base_; }
+    size_t size() const { return pages_ * page_size_; }
+    const char* tracker_name() const { return tracker_ ? tracker_->name() : "none"; }
+    size_t pages_rehashed() const { return last_rehashed_; }
+
+    // Returns the CRC-32 of the whole region. The first call hashes every page.
+    // Other threads must not write to the region while this runs, see DirtyTracker.
+    uint32_t checksum() {
+        std::vector<size_t> dirty;
+        if (!initialized_) {
+            tracker_->arm(); // before reading, so writes from now on are tracked
+            dirty.resize(pages_);
+            for (size_t i = 0; i < pages_; ++i) dirty[i] = i;
+            initialized_ = true;
+        } else {
+            dirty = tracker_->collect();
+        }
+
+        for (size_t page : dirty)
+            page_crcs_[page] = crc32_update(0, base_ + page * page_size_, page_size_);
+        last_rehashed_ = dirty.size();
+
+        uint32_t crc = 0; // CRC of the empty prefix
+        for (uint32_t page_crc : page_crcs_)
+            crc = shifter_->shift(crc) ^ page_crc;
+        return crc;
+    }
+
+private:
+    uint8_t* base_ = nullptr;
+    size_t page_size_ = 0;
+    size_t pages_ = 0;
+    bool initialized_ = false;
+    size_t last_rehashed_ = 0;
+    std::vector<uint32_t> page_crcs_;
+    std::unique_ptr<CrcShifter> shifter_;
+    std::unique_ptr<DirtyTracker> tracker_;
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    init_crc32_table();
+
+    RegionChecksummer region(256u << 20); // 256 MiB
+    if (!region.data()) {
+        std::cout << "ERROR: mmap failed" << std::endl;
+        return 1;
+    }
+    uint8_t* mem = region.data();
+    for (size_t i = 0; i < region.size(); ++i) mem[i] = static_cast<uint8_t>(i * 31 + (i >> 12));
+
+    std::cout << "Region: " << (region.size() >> 20) << " MiB, tracker: " << region.tracker_name() << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    auto t = std::chrono::steady_clock::now();
+    uint32_t crc = region.checksum();
+    std::cout << "[1] Initial check:     crc=0x" << std::hex << crc << std::dec << "  pages rehashed="
+              << region.pages_rehashed() << "  " << elapsed_ms(t) << " ms" << std::endl;
+
+    // Nothing written: only the fold over page CRCs remains.
+    t = std::chrono::steady_clock::now();
+    crc = region.checksum();
+    std::cout << "[2] No writes:         crc=0x" << std::hex << crc << std::dec << "  pages rehashed="
+              << region.pages_rehashed() << "  " << elapsed_ms(t) << " ms" << std::endl;
+
+    // Touch a handful of scattered pages.
+    for (size_t i = 0; i < 100; ++i) mem[(i * 7919 * 4096 + i) % region.size()] ^= 0x5A;
+    t = std::chrono::steady_clock::now();
+    crc = region.checksum();
+    std::cout << "[3] 100 pages written: crc=0x" << std::hex << crc << std::dec << "  pages rehashed="
+              << region.pages_rehashed() << "  " << elapsed_ms(t) << " ms" << std::endl;
+
+    // Cross-check against a plain full-region CRC.
+    t = std::chrono::steady_clock::now();
+    uint32_t full = crc32_update(0, mem, region.size());
+    std::cout << "[4] Full rescan:       crc=0x" << std::hex << full << std::dec << "  "
+              << elapsed_ms(t) << " ms  -> " << (full == crc ? "incremental CRC matches" : "MISMATCH")
+              << std::endl;
+
+    /*
+     * Output will show that after the first full pass, a check only costs time
+     * for the pages that were actually written (plus a cheap fold over the
+     * per-page CRCs), and that the combined CRC equals a full rescan.
+     */
+    return 0;
+}
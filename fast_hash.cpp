@@ -0,0 +1,791 @@
+/*
+ * fast_hash.cpp
+ * -------------
+ * A fast 64/128-bit non-cryptographic hash for hash tables and sharding.
+ *
+ * The checksums in checksums.cpp are 8-bit error detectors: 256 possible
+ * values, and the sum and XOR do not even depend on byte order. A hash table
+ * needs the opposite: every input bit should flip each output bit with
+ * probability 1/2 (avalanche), and distinct keys should practically never
+ * collide in 64 bits.
+ *
+ * The hash below follows the XXH3 algorithm (xxHash 0.8), so its outputs can
+ * be checked against the reference implementation:
+ *
+ *   len 0..16     one or two 64-bit reads, a 64x64->128 multiply, avalanche
+ *   len 17..240   16-byte lanes mixed with a 192-byte secret, summed
+ *   len > 240     8 accumulators x 64 bits, fed 64-byte stripes:
+ *                   acc[i^1] += data[i]
+ *                   acc[i]   += lo32(data[i] ^ key[i]) * hi32(data[i] ^ key[i])
+ *                 the accumulators are scrambled every 1 KiB, and merged with
+ *                 128-bit multiplies at the end
+ *
+ * The long-input loop is eight independent 32x32->64 multiplies per stripe,
+ * which maps onto one AVX-512 or two AVX2 vectors.
+ *
+ * 1. Primitives, the secret, and the short/medium paths.
+ * 2. Long inputs: scalar, AVX2 and AVX-512 stripe kernels, chosen at runtime.
+ * 3. One-shot API: hash64 / hash128, with a seed, for pointer+length and for
+ *    std::vector<uint8_t> like the checksum functions.
+ * 4. Streaming API: Hasher::update() in pieces of any size gives the same
+ *    result as the one-shot call on the concatenation.
+ * 5. Quality tests in the style of SMHasher: avalanche, sequential and sparse
+ *    key collisions, bucket distribution, seed independence.
+ * 6. Speed against the checksum functions.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <immintrin.h>
+
+// 1. Primitives
+// -------------
+constexpr uint32_t kPrime32_1 = 0x9E3779B1U;
+constexpr uint32_t kPrime32_2 = 0x85EBCA77U;
+constexpr uint32_t kPrime32_3 = 0xC2B2AE3DU;
+constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+constexpr uint64_t kPrimeMx1 = 0x165667919E3779F9ULL;
+constexpr uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+constexpr size_t kSecretSize = 192;
+constexpr size_t kStripeLen = 64;
+constexpr size_t kSecretConsumeRate = 8;                                     // secret bytes advanced per stripe
+constexpr size_t kStripesPerBlock = (kSecretSize - kStripeLen) / kSecretConsumeRate; // 16 stripes = 1 KiB
+constexpr size_t kBlockLen = kStripeLen * kStripesPerBlock;
+
+// The default secret of XXH3: 192 pseudo-random bytes the input is mixed with.
+alignas(64) const uint8_t kSecret[kSecretSize] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+struct Hash128 {
+    uint64_t low;
+    uint64_t high;
+    bool operator==(const Hash128& o) const { return low == o.low && high == o.high; }
+};
+
+inline uint32_t read32(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+inline uint64_t read64(const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+inline void write64(uint8_t* p, uint64_t v) { std::memcpy(p, &v, 8); }
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+inline uint32_t rotl32(uint32_t x, int r) { return (x << r) | (x >> (32 - r)); }
+
+inline Hash128 mul128(uint64_t a, uint64_t b) {
+    unsigned __int128 p = static_cast<unsigned __int128>(a) * b;
+    return {static_cast<uint64_t>(p), static_cast<uint64_t>(p >> 64)};
+}
+
+// The 128-bit product folded to 64 bits: the core mixing step.
+inline uint64_t mul128_fold64(uint64_t a, uint64_t b) {
+    Hash128 p = mul128(a, b);
+    return p.low ^ p.high;
+}
+
+inline uint64_t xxh64_avalanche(uint64_t h) {
+    h ^= h >> 33; h *= kPrime64_2;
+    h ^= h >> 29; h *= kPrime64_3;
+    return h ^ (h >> 32);
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37; h *= kPrimeMx1;
+    return h ^ (h >> 32);
+}
+
+inline uint64_t rrmxmx(uint64_t h, uint64_t len) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= kPrimeMx2;
+    h ^= (h >> 35) + len;
+    h *= kPrimeMx2;
+    return h ^ (h >> 28);
+}
+
+inline uint64_t mix16(const uint8_t* in, const uint8_t* secret, uint64_t seed) {
+    return mul128_fold64(read64(in) ^ (read64(secret) + seed), read64(in + 8) ^ (read64(secret + 8) - seed));
+}
+
+// 64-bit, 0..240 bytes
+// --------------------
+uint64_t hash64_0to16(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    if (len > 8) {
+        uint64_t lo = read64(in) ^ ((read64(secret + 24) ^ read64(secret + 32)) + seed);
+        uint64_t hi = read64(in + len - 8) ^ ((read64(secret + 40) ^ read64(secret + 48)) - seed);
+        return avalanche(len + __builtin_bswap64(lo) + hi + mul128_fold64(lo, hi));
+    }
+    if (len >= 4) {
+        seed ^= static_cast<uint64_t>(__builtin_bswap32(static_cast<uint32_t>(seed))) << 32;
+        uint64_t input = read32(in + len - 4) + (static_cast<uint64_t>(read32(in)) << 32);
+        return rrmxmx(input ^ ((read64(secret + 8) ^ read64(secret + 16)) - seed), len);
+    }
+    if (len > 0) {
+        uint32_t combined = (uint32_t(in[0]) << 16) | (uint32_t(in[len >> 1]) << 24) | in[len - 1] |
+                            (static_cast<uint32_t>(len) << 8);
+        return xxh64_avalanche(combined ^ ((read32(secret) ^ read32(secret + 4)) + seed));
+    }
+    return xxh64_avalanche(seed ^ read64(secret + 56) ^ read64(secret + 64));
+}
+
+uint64_t hash64_17to128(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    uint64_t acc = len * kPrime64_1;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += mix16(in + 48, secret + 96, seed);
+                acc += mix16(in + len - 64, secret + 112, seed);
+            }
+            acc += mix16(in + 32, secret + 64, seed);
+            acc += mix16(in + len - 48, secret + 80, seed);
+        }
+        acc += mix16(in + 16, secret + 32, seed);
+        acc += mix16(in + len - 32, secret + 48, seed);
+    }
+    acc += mix16(in, secret, seed);
+    acc += mix16(in + len - 16, secret + 16, seed);
+    return avalanche(acc);
+}
+
+uint64_t hash64_129to240(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    uint64_t acc = len * kPrime64_1;
+    for (size_t i = 0; i < 8; ++i) acc += mix16(in + 16 * i, secret + 16 * i, seed);
+    acc = avalanche(acc);
+    for (size_t i = 8; i < len / 16; ++i) acc += mix16(in + 16 * i, secret + 16 * (i - 8) + 3, seed);
+    acc += mix16(in + len - 16, secret + 136 - 17, seed);
+    return avalanche(acc);
+}
+
+// 128-bit, 0..240 bytes
+// ---------------------
+Hash128 hash128_0to16(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    if (len > 8) {
+        uint64_t flip_lo = (read64(secret + 32) ^ read64(secret + 40)) - seed;
+        uint64_t flip_hi = (read64(secret + 48) ^ read64(secret + 56)) + seed;
+        uint64_t lo = read64(in), hi = read64(in + len - 8);
+        Hash128 m = mul128(lo ^ hi ^ flip_lo, kPrime64_1);
+        m.low += static_cast<uint64_t>(len - 1) << 54;
+        hi ^= flip_hi;
+        m.high += hi + static_cast<uint64_t>(static_cast<uint32_t>(hi)) * (kPrime32_2 - 1);
+        m.low ^= __builtin_bswap64(m.high);
+        Hash128 h = mul128(m.low, kPrime64_2);
+        h.high += m.high * kPrime64_2;
+        return {avalanche(h.low), avalanche(h.high)};
+    }
+    if (len >= 4) {
+        seed ^= static_cast<uint64_t>(__builtin_bswap32(static_cast<uint32_t>(seed))) << 32;
+        uint64_t input = read32(in) + (static_cast<uint64_t>(read32(in + len - 4)) << 32);
+        uint64_t keyed = input ^ ((read64(secret + 16) ^ read64(secret + 24)) + seed);
+        Hash128 m = mul128(keyed, kPrime64_1 + (len << 2));
+        m.high += m.low << 1;
+        m.low ^= m.high >> 3;
+        m.low ^= m.low >> 35;
+        m.low *= kPrimeMx2;
+        m.low ^= m.low >> 28;
+        return {m.low, avalanche(m.high)};
+    }
+    if (len > 0) {
+        uint32_t combined_lo = (uint32_t(in[0]) << 16) | (uint32_t(in[len >> 1]) << 24) | in[len - 1] |
+                               (static_cast<uint32_t>(len) << 8);
+        uint32_t combined_hi = rotl32(__builtin_bswap32(combined_lo), 13);
+        uint64_t flip_lo = (read32(secret) ^ read32(secret + 4)) + seed;
+        uint64_t flip_hi = (read32(secret + 8) ^ read32(secret + 12)) - seed;
+        return {xxh64_avalanche(combined_lo ^ flip_lo), xxh64_avalanche(combined_hi ^ flip_hi)};
+    }
+    return {xxh64_avalanche(seed ^ read64(secret + 64) ^ read64(secret + 72)),
+            xxh64_avalanche(seed ^ read64(secret + 80) ^ read64(secret + 88))};
+}
+
+inline void mix32(Hash128& acc, const uint8_t* in1, const uint8_t* in2, const uint8_t* secret, uint64_t seed) {
+    acc.low += mix16(in1, secret, seed);
+    acc.low ^= read64(in2) + read64(in2 + 8);
+    acc.high += mix16(in2, secret + 16, seed);
+    acc.high ^= read64(in1) + read64(in1 + 8);
+}
+
+inline Hash128 finish128(Hash128 acc, size_t len, uint64_t seed) {
+    uint64_t low = acc.low + acc.high;
+    uint64_t high = acc.low * kPrime64_1 + acc.high * kPrime64_4 + (len - seed) * kPrime64_2;
+    return {avalanche(low), 0 - avalanche(high)};
+}
+
+Hash128 hash128_17to128(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    Hash128 acc{len * kPrime64_1, 0};
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) mix32(acc, in + 48, in + len - 64, secret + 96, seed);
+            mix32(acc, in + 32, in + len - 48, secret + 64, seed);
+        }
+        mix32(acc, in + 16, in + len - 32, secret + 32, seed);
+    }
+    mix32(acc, in, in + len - 16, secret, seed);
+    return finish128(acc, len, seed);
+}
+
+Hash128 hash128_129to240(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    Hash128 acc{len * kPrime64_1, 0};
+    for (size_t i = 0; i < 4; ++i) mix32(acc, in + 32 * i, in + 32 * i + 16, secret + 32 * i, seed);
+    acc = {avalanche(acc.low), avalanche(acc.high)};
+    for (size_t i = 4; i < len / 32; ++i) mix32(acc, in + 32 * i, in + 32 * i + 16, secret + 3 + 32 * (i - 4), seed);
+    mix32(acc, in + len - 16, in + len - 32, secret + 136 - 17 - 16, 0 - seed);
+    return finish128(acc, len, seed);
+}
+
+// 2. Long inputs
+// --------------
+// accumulate() feeds 'stripes' consecutive 64-byte stripes, advancing the
+// secret by 8 bytes per stripe; scramble() runs once per 1 KiB block.
+struct LongKernels {
+    const char* name;
+    void (*accumulate)(uint64_t* acc, const uint8_t* in, const uint8_t* secret, size_t stripes);
+    void (*scramble)(uint64_t* acc, const uint8_t* secret);
+};
+
+void accumulate_scalar(uint64_t* acc, const uint8_t* in, const uint8_t* secret, size_t stripes) {
+    for (size_t s = 0; s < stripes; ++s, in += kStripeLen, secret += kSecretConsumeRate)
+        for (size_t i = 0; i < 8; ++i) {
+            uint64_t data = read64(in + 8 * i);
+            uint64_t key = data ^ read64(secret + 8 * i);
+            acc[i ^ 1] += data;
+            acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+        }
+}
+
+void scramble_scalar(uint64_t* acc, const uint8_t* secret) {
+    for (size_t i = 0; i < 8; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(secret + 8 * i);
+        acc[i] = a * kPrime32_1;
+    }
+}
+
+__attribute__((target("avx2")))
+void accumulate_avx2(uint64_t* acc, const uint8_t* in, const uint8_t* secret, size_t stripes) {
+    __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+    __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + 4));
+    for (size_t s = 0; s < stripes; ++s, in += kStripeLen, secret += kSecretConsumeRate) {
+        __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+        __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32));
+        __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret)));
+        __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret + 32)));
+        // mul_epu32 multiplies the low 32 bits of each lane: lo32(key) * hi32(key).
+        __m256i p0 = _mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32));
+        __m256i p1 = _mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32));
+        // acc[i ^ 1] += data[i]: swap neighbouring 64-bit lanes.
+        a0 = _mm256_add_epi64(a0, _mm256_add_epi64(p0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+        a1 = _mm256_add_epi64(a1, _mm256_add_epi64(p1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + 4), a1);
+}
+
+__attribute__((target("avx2")))
+void scramble_avx2(uint64_t* acc, const uint8_t* secret) {
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32_1));
+    for (size_t i = 0; i < 8; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret + 8 * i)));
+        // 64 x 32 multiply from two 32 x 32 products.
+        __m256i lo = _mm256_mul_epu32(a, prime);
+        __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+    }
+}
+
+// GCC 12 warns about the _mm512_undefined_epi32() inside the AVX-512 shift,
+// multiply and shuffle intrinsics when they are compiled via target().
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+void accumulate_avx512(uint64_t* acc, const uint8_t* in, const uint8_t* secret, size_t stripes) {
+    __m512i a = _mm512_loadu_si512(acc);
+    for (size_t s = 0; s < stripes; ++s, in += kStripeLen, secret += kSecretConsumeRate) {
+        __m512i d = _mm512_loadu_si512(in);
+        __m512i k = _mm512_xor_si512(d, _mm512_loadu_si512(secret));
+        __m512i p = _mm512_mul_epu32(k, _mm512_srli_epi64(k, 32));
+        a = _mm512_add_epi64(a, _mm512_add_epi64(p, _mm512_shuffle_epi32(d, _MM_PERM_BADC)));
+    }
+    _mm512_storeu_si512(acc, a);
+}
+
+__attribute__((target("avx512f")))
+void scramble_avx512(uint64_t* acc, const uint8_t* secret) {
+    __m512i a = _mm512_loadu_si512(acc);
+    a = _mm512_xor_si512(a, _mm512_srli_epi64(a, 47));
+    a = _mm512_xor_si512(a, _mm512_loadu_si512(secret));
+    const __m512i prime = _mm512_set1_epi32(static_cast<int>(kPrime32_1));
+    __m512i lo = _mm512_mul_epu32(a, prime);
+    __m512i hi = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), prime);
+    _mm512_storeu_si512(acc, _mm512_add_epi64(lo, _mm512_slli_epi64(hi, 32)));
+}
+#pragma GCC diagnostic pop
+
+const LongKernels kScalarKernels{"scalar", accumulate_scalar, scramble_scalar};
+const LongKernels kAvx2Kernels{"avx2", accumulate_avx2, scramble_avx2};
+const LongKernels kAvx512Kernels{"avx512", accumulate_avx512, scramble_avx512};
+
+const LongKernels* select_long_kernels() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return &kAvx512Kernels;
+    if (__builtin_cpu_supports("avx2")) return &kAvx2Kernels;
+    return &kScalarKernels;
+}
+
+const LongKernels* g_long = select_long_kernels(); // the demo switches this to compare
+
+inline void init_acc(uint64_t* acc) {
+    const uint64_t init[8] = {kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3,
+                              kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1};
+    std::memcpy(acc, init, sizeof(init));
+}
+
+inline uint64_t merge_accs(const uint64_t* acc, const uint8_t* secret, uint64_t start) {
+    uint64_t result = start;
+    for (size_t i = 0; i < 4; ++i)
+        result += mul128_fold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+    return avalanche(result);
+}
+
+// The last stripe always ends at the end of the input, overlapping the
+// previous one if the length is not a multiple of 64.
+void hash_long(uint64_t* acc, const uint8_t* in, size_t len, const uint8_t* secret) {
+    init_acc(acc);
+    size_t blocks = (len - 1) / kBlockLen;
+    for (size_t b = 0; b < blocks; ++b) {
+        g_long->accumulate(acc, in + b * kBlockLen, secret, kStripesPerBlock);
+        g_long->scramble(acc, secret + kSecretSize - kStripeLen);
+    }
+    size_t stripes = ((len - 1) - blocks * kBlockLen) / kStripeLen;
+    g_long->accumulate(acc, in + blocks * kBlockLen, secret, stripes);
+    g_long->accumulate(acc, in + len - kStripeLen, secret + kSecretSize - kStripeLen - 7, 1);
+}
+
+// A seed changes the secret itself for long inputs, so the long loop costs the same.
+void derive_secret(uint8_t* custom, uint64_t seed) {
+    for (size_t i = 0; i < kSecretSize; i += 16) {
+        write64(custom + i, read64(kSecret + i) + seed);
+        write64(custom + i + 8, read64(kSecret + i + 8) - seed);
+    }
+}
+
+// 3. One-shot API
+// ---------------
+uint64_t hash64(const uint8_t* data, size_t len, uint64_t seed = 0) {
+    if (len <= 16) return hash64_0to16(data, len, kSecret, seed);
+    if (len <= 128) return hash64_17to128(data, len, kSecret, seed);
+    if (len <= 240) return hash64_129to240(data, len, kSecret, seed);
+    alignas(64) uint8_t custom[kSecretSize];
+    const uint8_t* secret = kSecret;
+    if (seed != 0) {
+        derive_secret(custom, seed);
+        secret = custom;
+    }
+    alignas(64) uint64_t acc[8];
+    hash_long(acc, data, len, secret);
+    return merge_accs(acc, secret + 11, len * kPrime64_1);
+}
+
+Hash128 hash128(const uint8_t* data, size_t len, uint64_t seed = 0) {
+    if (len <= 16) return hash128_0to16(data, len, kSecret, seed);
+    if (len <= 128) return hash128_17to128(data, len, kSecret, seed);
+    if (len <= 240) return hash128_129to240(data, len, kSecret, seed);
+    alignas(64) uint8_t custom[kSecretSize];
+    const uint8_t* secret = kSecret;
+    if (seed != 0) {
+        derive_secret(custom, seed);
+        secret = custom;
+    }
+    alignas(64) uint64_t acc[8];
+    hash_long(acc, data, len, secret);
+    return {merge_accs(acc, secret + 11, len * kPrime64_1),
+            merge_accs(acc, secret + kSecretSize - kStripeLen - 11, ~(len * kPrime64_2))};
+}
+
+uint64_t hash64(const std::vector<uint8_t>& data, uint64_t seed = 0) { return hash64(data.data(), data.size(), seed); }
+Hash128 hash128(const std::vector<uint8_t>& data, uint64_t seed = 0) { return hash128(data.data(), data.size(), seed); }
+
+// 4. Streaming API
+// ----------------
+// Input is buffered 256 bytes (4 stripes) at a time. At least one byte always
+// stays buffered, so digest() can tell a short input from a long one and the
+// final stripe can end exactly at the end of the input, as in hash_long().
+class Hasher {
+public:
+    explicit Hasher(uint64_t seed = 0) { reset(seed); }
+
+    void reset(uint64_t seed = 0) {
+        seed_ = seed;
+        if (seed == 0) std::memcpy(secret_, kSecret, kSecretSize);
+        else derive_secret(secret_, seed);
+        init_acc(acc_);
+        buffered_ = 0;
+        stripes_so_far_ = 0;
+        total_len_ = 0;
+    }
+
+    void update(const uint8_t* in, size_t len) {
+        total_len_ += len;
+        if (len <= kBufferSize - buffered_) {
+            std::memcpy(buffer_ + buffered_, in, len);
+            buffered_ += len;
+            return;
+        }
+        const uint8_t* end = in + len;
+        if (buffered_ > 0) {
+            size_t fill = kBufferSize - buffered_;
+            std::memcpy(buffer_ + buffered_, in, fill);
+            in += fill;
+            consume(acc_, stripes_so_far_, buffer_, kBufferStripes);
+            buffered_ = 0;
+        }
+        if (end - in > static_cast<std::ptrdiff_t>(kBufferSize)) {
+            // Whole blocks straight from the input, no copy.
+            size_t stripes = (end - in - 1) / kStripeLen;
+            consume(acc_, stripes_so_far_, in, stripes);
+            in += stripes * kStripeLen;
+            std::memcpy(buffer_ + kBufferSize - kStripeLen, in - kStripeLen, kStripeLen); // for digest()
+        }
+        std::memcpy(buffer_, in, end - in);
+        buffered_ = end - in;
+    }
+
+    void update(const std::vector<uint8_t>& data) { update(data.data(), data.size()); }
+
+    uint64_t digest64() const {
+        if (total_len_ <= 240) return hash64(buffer_, total_len_, seed_);
+        alignas(64) uint64_t acc[8];
+        finish_long(acc);
+        return merge_accs(acc, secret_ + 11, total_len_ * kPrime64_1);
+    }
+
+    Hash128 digest128() const {
+        if (total_len_ <= 240) return hash128(buffer_, total_len_, seed_);
+        alignas(64) uint64_t acc[8];
+        finish_long(acc);
+        return {merge_accs(acc, secret_ + 11, total_len_ * kPrime64_1),
+                merge_accs(acc, secret_ + kSecretSize - kStripeLen - 11, ~(total_len_ * kPrime64_2))};
+    }
+
+private:
+    static constexpr size_t kBufferSize = 256;
+    static constexpr size_t kBufferStripes = kBufferSize / kStripeLen;
+
+    // Feeds stripes, scrambling whenever a 1 KiB block of the secret is used up.
+    void consume(uint64_t* acc, size_t& so_far, const uint8_t* in, size_t stripes) const {
+        while (stripes > 0) {
+            size_t n = std::min(stripes, kStripesPerBlock - so_far);
+            g_long->accumulate(acc, in, secret_ + so_far * kSecretConsumeRate, n);
+            in += n * kStripeLen;
+            stripes -= n;
+            so_far += n;
+            if (so_far == kStripesPerBlock) {
+                g_long->scramble(acc, secret_ + kSecretSize - kStripeLen);
+                so_far = 0;
+            }
+        }
+    }
+
+    void finish_long(uint64_t* acc) const {
+        std::memcpy(acc, acc_, sizeof(acc_));
+        alignas(64) uint8_t last[kStripeLen];
+        if (buffered_ >= kStripeLen) {
+            size_t so_far = stripes_so_far_;
+            consume(acc, so_far, buffer_, (buffered_ - 1) / kStripeLen);
+            std::memcpy(last, buffer_ + buffered_ - kStripeLen, kStripeLen);
+        } else {
+            // The tail of the previous stripe sits at the end of the buffer.
+            size_t catchup = kStripeLen - buffered_;
+            std::memcpy(last, buffer_ + kBufferSize - catchup, catchup);
+            std::memcpy(last + catchup, buffer_, buffered_);
+        }
+        g_long->accumulate(acc, last, secret_ + kSecretSize - kStripeLen - 7, 1);
+    }
+
+    alignas(64) uint64_t acc_[8];
+    alignas(64) uint8_t secret_[kSecretSize];
+    alignas(64) uint8_t buffer_[kBufferSize];
+    size_t buffered_;
+    size_t stripes_so_far_;
+    uint64_t total_len_;
+    uint64_t seed_;
+};
+
+// 5. Quality tests
+// ----------------
+uint64_t next_random(uint64_t& x) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    return x;
+}
+
+// Flips each input bit of random keys; each output bit should then flip with
+// probability 1/2. Returns the worst |2 * P(flip) - 1| over all (input bit,
+// output bit) pairs, and in 'noise' what an ideal hash would show with the
+// same number of trials (the expected maximum of that many sampling errors).
+double avalanche_bias(size_t key_len, size_t trials, double& noise) {
+    std::vector<uint32_t> flips(key_len * 8 * 64, 0);
+    std::vector<uint8_t> key(key_len);
+    uint64_t x = 0x853C49E6748FEA9Bull + key_len;
+    for (size_t t = 0; t < trials; ++t) {
+        for (uint8_t& b : key) b = static_cast<uint8_t>(next_random(x));
+        uint64_t h = hash64(key.data(), key_len);
+        for (size_t bit = 0; bit < key_len * 8; ++bit) {
+            key[bit / 8] ^= 1 << (bit % 8);
+            uint64_t d = h ^ hash64(key.data(), key_len);
+            key[bit / 8] ^= 1 << (bit % 8);
+            uint32_t* f = &flips[bit * 64];
+            for (int o = 0; o < 64; ++o) f[o] += (d >> o) & 1;
+        }
+    }
+    double worst = 0;
+    for (uint32_t f : flips) worst = std::max(worst, std::fabs(2.0 * f / trials - 1.0));
+    noise = std::sqrt(2.0 * std::log(2.0 * flips.size())) / std::sqrt(static_cast<double>(trials));
+    return worst;
+}
+
+// Counts full 64-bit collisions (should be 0) and collisions of the low 32
+// bits against the birthday expectation n^2 / 2^33.
+void collision_report(const char* label, std::vector<uint64_t> h) {
+    size_t n = h.size();
+    std::sort(h.begin(), h.end());
+    size_t full = 0;
+    for (size_t i = 1; i < n; ++i) full += h[i] == h[i - 1];
+    for (uint64_t& v : h) v &= 0xFFFFFFFF;
+    std::sort(h.begin(), h.end());
+    size_t low32 = 0;
+    for (size_t i = 1; i < n; ++i) low32 += h[i] == h[i - 1];
+    double expected = static_cast<double>(n) * n / 8589934592.0;
+    std::cout << "  " << std::left << std::setw(30) << label << std::right << std::setw(8) << n << " keys: " << full
+              << " 64-bit collisions, " << std::setw(5) << low32 << " in the low 32 bits (expected "
+              << std::setprecision(0) << expected << ")" << std::endl;
+}
+
+// Chi-square of 16 output bits over 2^16 buckets, as a z-score: an ideal hash
+// gives |z| < 3 almost always.
+double bucket_z(size_t n, int shift) {
+    const size_t buckets = 1 << 16;
+    std::vector<uint32_t> count(buckets, 0);
+    for (uint64_t i = 0; i < n; ++i) {
+        uint8_t key[8];
+        std::memcpy(key, &i, 8);
+        ++count[(hash64(key, 8) >> shift) & (buckets - 1)];
+    }
+    double expected = static_cast<double>(n) / buckets, chi2 = 0;
+    for (uint32_t c : count) chi2 += (c - expected) * (c - expected) / expected;
+    return (chi2 - (buckets - 1)) / std::sqrt(2.0 * (buckets - 1));
+}
+
+// 6. Speed
+// --------
+template <typename Callback>
+double time_ms(Callback cb) {
+    auto t = std::chrono::steady_clock::now();
+    cb();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+struct Crc8Table {
+    uint8_t t[256];
+    Crc8Table() {
+        for (int n = 0; n < 256; ++n) {
+            uint8_t c = static_cast<uint8_t>(n);
+            for (int i = 0; i < 8; ++i) c = (c & 0x80) ? (c << 1) ^ 0x07 : c << 1;
+            t[n] = c;
+        }
+    }
+};
+static const Crc8Table kCrc8;
+
+uint64_t crc8_table(const uint8_t* data, size_t len, uint64_t = 0) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; ++i) crc = kCrc8.t[crc ^ data[i]];
+    return crc;
+}
+
+uint64_t sum_checksum(const uint8_t* data, size_t len, uint64_t = 0) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len; ++i) sum += data[i];
+    return sum & 0xFF;
+}
+
+// GB/s of fn over 'len'-byte inputs at consecutive offsets of 'buf'.
+template <typename Fn>
+double throughput(Fn fn, const std::vector<uint8_t>& buf, size_t len) {
+    size_t calls = std::max<size_t>(1, (size_t(256) << 20) / std::max<size_t>(len, 16));
+    size_t span = buf.size() - len;
+    uint64_t sink = 0;
+    double ms = time_ms([&] {
+        for (size_t i = 0, off = 0; i < calls; ++i) {
+            sink += fn(buf.data() + off, len, 0);
+            off += 64;
+            if (off > span) off = 0;
+        }
+    });
+    if (sink == 42) std::cout << "";
+    return static_cast<double>(calls) * len / (ms * 1e6);
+}
+
+int main() {
+    std::vector<uint8_t> msg(2048);
+    for (size_t i = 0; i < msg.size(); ++i) msg[i] = static_cast<uint8_t>(i * 7 + 3);
+    const LongKernels* best = g_long;
+    std::vector<const LongKernels*> kernels{&kScalarKernels};
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(&kAvx2Kernels);
+    if (__builtin_cpu_supports("avx512f")) kernels.push_back(&kAvx512Kernels);
+
+    // [1] Known answers from the xxHash reference (XXH3_64bits_withSeed and
+    //     XXH3_128bits_withSeed), covering every length class, with every kernel.
+    struct Known { size_t len; uint64_t seed; uint64_t h64; uint64_t h128_lo; uint64_t h128_hi; };
+    const Known known[] = {
+        {0, 0, 0x2d06800538d394c2ULL, 0x6001c324468d497fULL, 0x99aa06d3014798d8ULL},
+        {3, 0, 0xa9088dda485b481cULL, 0xa9088dda485b481cULL, 0xce31763cbf8245a5ULL},
+        {8, 0, 0x60539db630471163ULL, 0x3cd024e3d63a1588ULL, 0xe3bc8a5f46171555ULL},
+        {16, 0, 0xb8c859b0f030b585ULL, 0x60d75c5e47d40a24ULL, 0xce0b9647ab24f884ULL},
+        {100, 0, 0xb5937857f0d78c9fULL, 0x0cc97f05750182b2ULL, 0x2207ed96998d91f2ULL},
+        {200, 0, 0x746cd0025327bf5bULL, 0x380142cdd5843bbdULL, 0x32200a52a918beafULL},
+        {1000, 0, 0x6c4f14bd97bd9e82ULL, 0x6c4f14bd97bd9e82ULL, 0x6bcc7eff62da44c2ULL},
+        {2048, 0, 0xabe604813ba62ed1ULL, 0xabe604813ba62ed1ULL, 0xf81f6e8f418d8075ULL},
+        {5, 42, 0x364f22c93f4774f2ULL, 0x5629653a1cfada93ULL, 0xf16ee860961d7731ULL},
+        {64, 42, 0x2b5ea8e567ef1236ULL, 0x67c5ec96b148a3f4ULL, 0x5526475333679b16ULL},
+        {240, 42, 0x722964f8a7f16de3ULL, 0x86f083bfa5cd536eULL, 0x769e935f5f439775ULL},
+        {2048, 42, 0xdd4c81a05a30cf87ULL, 0xdd4c81a05a30cf87ULL, 0xdb7c2828104d3c7aULL},
+    };
+    std::cout << "[1] Known answers (message bytes i * 7 + 3)" << std::endl;
+    for (const LongKernels* k : kernels) {
+        g_long = k;
+        size_t ok = 0;
+        for (const Known& v : known) {
+            Hash128 h = hash128(msg.data(), v.len, v.seed);
+            ok += hash64(msg.data(), v.len, v.seed) == v.h64 && h.low == v.h128_lo && h.high == v.h128_hi;
+        }
+        std::cout << "  " << std::left << std::setw(8) << k->name << std::right << ok << "/"
+                  << sizeof(known) / sizeof(known[0]) << " match" << std::endl;
+    }
+    g_long = best;
+
+    // [2] Streaming in random pieces equals one-shot, for every length up to 2 KiB.
+    {
+        size_t mismatches = 0;
+        uint64_t x = 0x2545F4914F6CDD1Dull;
+        for (size_t len = 0; len <= msg.size(); ++len) {
+            uint64_t seed = len % 3 == 0 ? 0 : next_random(x);
+            Hasher h(seed);
+            for (size_t pos = 0; pos < len;) {
+                size_t piece = std::min<size_t>(next_random(x) % 600, len - pos);
+                h.update(msg.data() + pos, piece);
+                pos += piece;
+            }
+            mismatches += h.digest64() != hash64(msg.data(), len, seed) || !(h.digest128() == hash128(msg.data(), len, seed));
+        }
+        std::cout << "[2] Streaming vs one-shot, lengths 0.." << msg.size() << ", random pieces: " << mismatches
+                  << " mismatches" << std::endl;
+    }
+
+    // [3] Avalanche.
+    std::cout << "[3] Avalanche: worst |2 P(output bit flips) - 1| over all input/output bit pairs" << std::endl;
+    std::cout << std::fixed;
+    for (size_t len : {4, 8, 16, 33, 128, 200, 256, 1024}) {
+        size_t trials = std::min<size_t>(100000, (size_t(8) << 20) / (len * 8));
+        double noise;
+        double worst = avalanche_bias(len, trials, noise);
+        std::cout << "  " << std::setw(5) << len << " bytes, " << std::setw(6) << trials << " keys: worst "
+                  << std::setprecision(2) << std::setw(5) << worst * 100 << "% (sampling noise of an ideal hash ~"
+                  << noise * 100 << "%) " << (worst < std::max(0.01, 1.3 * noise) ? "ok" : "BIASED") << std::endl;
+    }
+
+    // [4] Collisions on structured keys, where weak hashes fail.
+    std::cout << "[4] Collisions" << std::endl;
+    std::vector<uint64_t> h;
+    for (uint64_t i = 0; i < 4000000; ++i) h.push_back(hash64(reinterpret_cast<const uint8_t*>(&i), 8));
+    collision_report("sequential uint64", std::move(h));
+
+    h.clear();
+    uint8_t key[32] = {};
+    for (int a = 0; a < 256; ++a) { // every 256-bit key with one, two or three bits set
+        key[a / 8] ^= 1 << (a % 8);
+        h.push_back(hash64(key, 32));
+        for (int b = a + 1; b < 256; ++b) {
+            key[b / 8] ^= 1 << (b % 8);
+            h.push_back(hash64(key, 32));
+            for (int c = b + 1; c < 256; ++c) {
+                key[c / 8] ^= 1 << (c % 8);
+                h.push_back(hash64(key, 32));
+                key[c / 8] ^= 1 << (c % 8);
+            }
+            key[b / 8] ^= 1 << (b % 8);
+        }
+        key[a / 8] ^= 1 << (a % 8);
+    }
+    collision_report("sparse 32 bytes, 1-3 bits set", std::move(h));
+
+    h.clear();
+    for (size_t i = 0; i < 4000000; ++i) {
+        std::string s = "user:" + std::to_string(i);
+        h.push_back(hash64(reinterpret_cast<const uint8_t*>(s.data()), s.size()));
+    }
+    collision_report("text \"user:<n>\"", std::move(h));
+
+    h.clear();
+    std::vector<uint8_t> fixed(300, 0xAB);
+    for (uint64_t seed = 0; seed < 1000000; ++seed) h.push_back(hash64(fixed, seed));
+    collision_report("one 300-byte key, seeds 0..n", std::move(h));
+
+    // [5] Distribution of sequential keys over 2^16 buckets.
+    std::cout << "[5] Buckets (2^16, 4M sequential uint64 keys), chi-square z-score:" << std::setprecision(2)
+              << " bits 0-15 " << bucket_z(4000000, 0) << ", bits 24-39 " << bucket_z(4000000, 24) << ", bits 48-63 "
+              << bucket_z(4000000, 48) << std::endl;
+
+    // [6] Speed.
+    std::vector<uint8_t> buf((size_t(1) << 20) + 4096);
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (uint8_t& b : buf) b = static_cast<uint8_t>(next_random(x));
+    std::cout << "[6] Throughput, GB/s" << std::endl;
+    std::cout << "  " << std::setw(8) << "bytes" << std::setw(11) << "sum" << std::setw(11) << "crc8" << std::setw(11)
+              << "h128";
+    for (const LongKernels* k : kernels) std::cout << std::setw(11) << (std::string("h64 ") + k->name);
+    std::cout << std::endl;
+    for (size_t len : {8, 16, 64, 240, 1024, 16384, 1048576}) {
+        std::cout << "  " << std::setw(8) << len << std::setw(11) << throughput(sum_checksum, buf, len) << std::setw(11)
+                  << throughput(crc8_table, buf, len) << std::setw(11)
+                  << throughput([](const uint8_t* p, size_t n, uint64_t s) { return hash128(p, n, s).low; }, buf, len);
+        for (const LongKernels* k : kernels) {
+            g_long = k;
+            std::cout << std::setw(11)
+                      << throughput([](const uint8_t* p, size_t n, uint64_t s) { return hash64(p, n, s); }, buf, len);
+        }
+        g_long = best;
+        std::cout << std::endl;
+    }
+
+    /*
+     * The 64-bit hash is the one for hash tables; the 128-bit one is for
+     * content addressing, where billions of keys would make a 64-bit collision
+     * plausible. Neither is a defence against an attacker who can choose keys
+     * to collide: for that, use a secret random seed at least, or SHA-256.
+     * Inputs up to 16 bytes take a few nanoseconds, which is call overhead
+     * for the throughput loop; the vector kernels only matter above 240 bytes.
+     */
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * hierarchical_bitmap.cpp
+ * -----------------------
+ * A bitmap with "find the next set bit after i" in O(log64 n) instead of O(n/64).
+ *
+ * With a flat bitmap, the masking from bitwise_and.cpp finds the next set bit
+ * inside one word quickly:
+ *     word & (~0ULL << (i & 63))   -> clear the bits below i, then count trailing zeros
+ * but if the word is empty every following word has to be scanned, which is
+ * O(n/64) for a sparse bitmap.
+ *
+ * The hierarchical version adds summary levels. Bit j of a level-k word is set
+ * when word j below it is non-zero ("anything set down there?"):
+ *
+ *   level 2:  [ 1 word  ]                 64 * 64 * 64 = 2^18 bits covered
+ *   level 1:  [ 64 words ]
+ *   level 0:  [ 4096 words ]  the actual bits
+ *
+ * For 2^24 bits there are 4 levels (2^18, 2^12, 2^6 and 1 words). The upper
+ * levels are tiny and stay in cache, so:
+ * - set / clear touch one word per level, and stop early once the summary bit
+ *   already has the right value;
+ * - find_next climbs until a summary word has a set bit to the right of the
+ *   current position, then descends with count-trailing-zeros, one word per level;
+ * - find_prev does the same to the left with count-leading-zeros.
+ */
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <string>
+#include <iterator>
+#include <chrono>
+#include <iomanip>
+#include <cstdint>
+
+class HierarchicalBitmap {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    explicit HierarchicalBitmap(size_t bits) : bits_(bits) {
+        // Level sizes from the bottom up until a single word remains.
+        size_t words = (bits + 63) / 64;
+        if (words == 0) words = 1;
+        size_t offset = 0;
+        for (;;) {
+            offsets_.push_back(offset);
+            offset += words;
+            if (words == 1) break;
+            words = (words + 63) / 64;
+        }
+        words_.assign(offset, 0);
+    }
+
+    size_t size() const { return bits_; }
+    size_t levels() const { return offsets_.size(); }
+    bool empty() const { return words_[offsets_.back()] == 0; }
+
+    bool test(size_t i) const { return word(0, i >> 6) >> (i & 63) & 1; }
+
+    void set(size_t i) {
+        for (size_t level = 0; level < levels(); ++level) {
+            uint64_t& w = word(level, i >> 6);
+            bool was_empty = (w == 0);
+            w |= uint64_t(1) << (i & 63);
+            if (!was_empty) return; // the summary bit above is already set
+            i >>= 6;
+        }
+    }
+
+    void clear(size_t i) {
+        for (size_t level = 0; level < levels(); ++level) {
+            uint64_t& w = word(level, i >> 6);
+            w &= ~(uint64_t(1) << (i & 63));
+            if (w != 0) return; // still something set below the summary bit
+            i >>= 6;
+        }
+    }
+
+    // First set bit >= i, or npos.
+    size_t find_next(size_t i) const {
+        if (i >= bits_) return npos;
+        size_t level = 0;
+        uint64_t w;
+        // Climb: look at the bits at or to the right of i within the current word.
+        for (;;) {
+            w = word(level, i >> 6) & (~uint64_t(0) << (i & 63));
+            if (w != 0) break;
+            if (level + 1 == levels()) return npos;
+            i = (i >> 6) + 1; // the word after ours, one level up
+            ++level;
+            if ((i >> 6) >= level_words(level)) return npos;
+        }
+        // Descend: always take the lowest set bit.
+        i = (i & ~size_t(63)) | static_cast<size_t>(__builtin_ctzll(w));
+        while (level > 0) {
+            --level;
+            i = (i << 6) | static_cast<size_t>(__builtin_ctzll(word(level, i)));
+        }
+        return i;
+    }
+
+    // Last set bit <= i, or npos.
+    size_t find_prev(size_t i) const {
+        if (bits_ == 0) return npos;
+        if (i >= bits_) i = bits_ - 1;
+        size_t level = 0;
+        uint64_t w;
+        for (;;) {
+            w = word(level, i >> 6) & (~uint64_t(0) >> (63 - (i & 63)));
+            if (w != 0) break;
+            if (level + 1 == levels() || (i >> 6) == 0) return npos;
+            i = (i >> 6) - 1; // the word before ours, one level up
+            ++level;
+        }
+        i = (i & ~size_t(63)) | static_cast<size_t>(63 - __builtin_clzll(w));
+        while (level > 0) {
+            --level;
+            i = (i << 6) | static_cast<size_t>(63 - __builtin_clzll(word(level, i)));
+        }
+        return i;
+    }
+
+private:
+    size_t level_words(size_t level) const {
+        size_t end = level + 1 < levels() ? offsets_[level + 1] : words_.size();
+        return end - offsets_[level];
+    }
+    uint64_t& word(size_t level, size_t index) { return words_[offsets_[level] + index]; }
+    uint64_t word(size_t level, size_t index) const { return words_[offsets_[level] + index]; }
+
+    size_t bits_;
+    std::vector<size_t> offsets_; // start of each level in words_, level 0 first
+    std::vector<uint64_t> words_;
+};
+
+// The flat approach for comparison: mask the first word, then scan word by word.
+class FlatBitmap {
+public:
+    explicit FlatBitmap(size_t bits) : bits_(bits), words_((bits + 63) / 64, 0) {}
+    void set(size_t i) { words_[i >> 6] |= uint64_t(1) << (i & 63); }
+    void clear(size_t i) { words_[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    size_t find_next(size_t i) const {
+        if (i >= bits_) return HierarchicalBitmap::npos;
+        size_t w = i >> 6;
+        uint64_t v = words_[w] & (~uint64_t(0) << (i & 63));
+        while (v == 0) {
+            if (++w == words_.size()) return HierarchicalBitmap::npos;
+            v = words_[w];
+        }
+        return (w << 6) + static_cast<size_t>(__builtin_ctzll(v));
+    }
+
+private:
+    size_t bits_;
+    std::vector<uint64_t> words_;
+};
+
+uint64_t next_random(uint64_t& x) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    return x;
+}
+
+int main() {
+    const size_t bits = size_t(1) << 24;
+    HierarchicalBitmap bm(bits);
+    std::cout << "[1] " << bits << " bits in " << bm.levels() << " levels" << std::endl;
+
+    bm.set(5);
+    bm.set(70000);
+    bm.set(bits - 1);
+    std::cout << "find_next(0) = " << bm.find_next(0) << ", find_next(6) = " << bm.find_next(6)
+              << ", find_next(70001) = " << bm.find_next(70001) << std::endl;
+    std::cout << "find_prev(69999) = " << bm.find_prev(69999) << ", find_prev(4) = "
+              << (bm.find_prev(4) == bm.npos ? std::string("npos") : std::to_string(bm.find_prev(4))) << std::endl;
+    bm.clear(5);
+    bm.clear(70000);
+    bm.clear(bits - 1);
+    std::cout << "after clearing everything, empty() = " << bm.empty() << std::endl << std::endl;
+
+    // 2. Randomized cross-check against std::set.
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    std::set<size_t> reference;
+    int errors = 0;
+    for (int op = 0; op < 200000; ++op) {
+        size_t i = next_random(x) % bits;
+        switch (next_random(x) % 4) {
+        case 0: bm.set(i); reference.insert(i); break;
+        case 1: bm.clear(i); reference.erase(i); break;
+        case 2: {
+            auto it = reference.lower_bound(i);
+            if (bm.find_next(i) != (it == reference.end() ? bm.npos : *it)) ++errors;
+            break;
+        }
+        default: {
+            auto it = reference.upper_bound(i);
+            if (bm.find_prev(i) != (it == reference.begin() ? bm.npos : *std::prev(it))) ++errors;
+        }
+        }
+    }
+    std::cout << "[2] 200000 random set/clear/find ops vs std::set: "
+              << (errors == 0 ? "all match" : "MISMATCHES") << std::endl << std::endl;
+
+    // 3. Sparse bitmap: a few hundred bits set out of 16M (e.g. armed timers).
+    HierarchicalBitmap sparse(bits);
+    FlatBitmap flat(bits);
+    for (int k = 0; k < 256; ++k) {
+        size_t i = next_random(x) % bits;
+        sparse.set(i);
+        flat.set(i);
+    }
+    auto time_walk = [&](auto& b, const char* label) {
+        auto t = std::chrono::steady_clock::now();
+        size_t count = 0, sum = 0;
+        for (int rep = 0; rep < 100; ++rep)
+            for (size_t i = b.find_next(0); i != HierarchicalBitmap::npos; i = b.find_next(i + 1)) {
+                ++count;
+                sum += i;
+            }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count();
+        std::cout << "  " << label << std::fixed << std::setprecision(1) << us / count * 1000
+                  << " ns per find_next (" << count / 100 << " bits, checksum " << sum % 1000 << ")" << std::endl;
+    };
+    std::cout << "[3] Iterating 256 set bits out of 2^24" << std::endl;
+    time_walk(flat, "flat scan:    ");
+    time_walk(sparse, "hierarchical: ");
+    return 0;
+}
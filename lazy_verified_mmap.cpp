@@ -0,0 +1,392 @@
+/*
+ * lazy_verified_mmap.cpp
+ * ----------------------
+ * Memory-mapped files that are checksum-verified block by block, the first
+ * time each block is touched, instead of all at once before first use.
+ *
+ * 1. Block index: a sidecar file ("<file>.crcidx") stores one CRC-32 per
+ *    fixed-size block, written when the data file is produced.
+ * 2. Fault-in layer: the file is mapped twice, sharing the same page cache:
+ *    - the user-visible mapping starts as PROT_NONE, so the first read of any
+ *      block raises SIGSEGV;
+ *    - a second, read-only "shadow" mapping lets the fault handler compute the
+ *      CRC of that block.
+ *    If the CRC matches, the handler makes the block readable and the faulting
+ *    instruction is retried. Otherwise the corruption policy runs (default:
+ *    report and abort), so unverified bytes are never handed to the application.
+ * 3. Explicit API: verify_range() checks blocks up front and returns a status,
+ *    for callers that prefer an error code over a fault.
+ *
+ * Opening is O(1) apart from reading the index, so startup no longer waits for
+ * the whole file to be checksummed. Each block is verified at most once.
+ *
+ * Only user-space loads fault in blocks. A system call that reads unverified
+ * bytes (e.g. write(fd, data(), n)) fails with EFAULT instead of triggering
+ * verification, so call verify_range() before handing the mapping to the kernel.
+ *
+ * A userfaultfd-based variant (UFFDIO_COPY after verifying) would also work,
+ * but it copies every block and needs a handler thread; mprotect keeps the
+ * file zero-copy and matches dirty_page_checksum.cpp.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// 1. CRC-32 (IEEE, reflected polynomial 0xEDB88320)
+// -------------------------------------------------
+static uint32_t crc32_table[256];
+
+void init_crc32_table() {
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : c >> 1;
+        crc32_table[n] = c;
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i)
+        crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// 2. Block index
+// --------------
+// Layout: "BIX1" block_size(u32) file_size(u64) crc(u32) * block_count, native endian.
+struct BlockIndex {
+    uint32_t block_size = 0;
+    uint64_t file_size = 0;
+    std::vector<uint32_t> crcs;
+};
+
+bool build_block_index(const std::string& path, uint32_t block_size) {
+    std::ifstream in(path, std::ios::binary);
+    std::ofstream out(path + ".crcidx", std::ios::binary);
+    if (!in || !out) return false;
+
+    BlockIndex index;
+    index.block_size = block_size;
+    std::vector<uint8_t> block(block_size);
+    while (in.read(reinterpret_cast<char*>(block.data()), block_size) || in.gcount() > 0) {
+        size_t n = static_cast<size_t>(in.gcount());
+        index.crcs.push_back(crc32_update(0, block.data(), n));
+        index.file_size += n;
+    }
+    out.write("BIX1", 4);
+    out.write(reinterpret_cast<const char*>(&index.block_size), sizeof(index.block_size));
+    out.write(reinterpret_cast<const char*>(&index.file_size), sizeof(index.file_size));
+    out.write(reinterpret_cast<const char*>(index.crcs.data()),
+              static_cast<std::streamsize>(index.crcs.size() * sizeof(uint32_t)));
+    return static_cast<bool>(out);
+}
+
+bool load_block_index(const std::string& path, BlockIndex& index) {
+    std::ifstream in(path + ".crcidx", std::ios::binary);
+    char magic[4];
+    if (!in.read(magic, 4) || std::memcmp(magic, "BIX1", 4) != 0) return false;
+    in.read(reinterpret_cast<char*>(&index.block_size), sizeof(index.block_size));
+    in.read(reinterpret_cast<char*>(&index.file_size), sizeof(index.file_size));
+    if (!in || index.block_size == 0) return false;
+    index.crcs.resize((index.file_size + index.block_size - 1) / index.block_size);
+    in.read(reinterpret_cast<char*>(index.crcs.data()),
+            static_cast<std::streamsize>(index.crcs.size() * sizeof(uint32_t)));
+    return static_cast<bool>(in);
+}
+
+// 3. The lazily verified mapping
+// ------------------------------
+// Called from the fault handler when a block fails verification. Must be
+// async-signal-safe and should not return (the data is unusable); if it does,
+// the handler aborts.
+typedef void (*CorruptionPolicy)(const char* path, size_t block);
+
+// Async-signal-safe: write() of preformatted pieces only, no stdio.
+void write_stderr(const char* s) {
+    if (write(STDERR_FILENO, s, strlen(s)) < 0) {}
+}
+
+void abort_on_corruption(const char* path, size_t block) {
+    char digits[24];
+    char* d = digits + sizeof(digits);
+    *--d = '\0';
+    do *--d = static_cast<char>('0' + block % 10); while (block /= 10);
+    write_stderr("FATAL: block ");
+    write_stderr(d);
+    write_stderr(" of ");
+    write_stderr(path);
+    write_stderr(" failed CRC verification\n");
+    abort();
+}
+
+class LazyVerifiedFile {
+public:
+    enum BlockState : uint8_t { UNVERIFIED = 0, VERIFIED = 1, CORRUPT = 2 };
+
+    LazyVerifiedFile() = default;
+    LazyVerifiedFile(const LazyVerifiedFile&) = delete;
+    LazyVerifiedFile& operator=(const LazyVerifiedFile&) = delete;
+    ~LazyVerifiedFile() { close(); }
+
+    // Maps 'path' using the block index previously written by build_block_index().
+    bool open(const std::string& path, CorruptionPolicy policy = abort_on_corruption) {
+        close();
+        path_ = path;
+        policy_ = policy;
+        long page = sysconf(_SC_PAGESIZE);
+        if (!load_block_index(path, index_) || index_.block_size % page != 0) return false;
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != index_.file_size) {
+            ::close(fd);
+            return false;
+        }
+        length_ = index_.file_size;
+        void* user = mmap(nullptr, length_, PROT_NONE, MAP_SHARED, fd, 0);
+        void* shadow = mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (user == MAP_FAILED || shadow == MAP_FAILED) {
+            if (user != MAP_FAILED) munmap(user, length_);
+            if (shadow != MAP_FAILED) munmap(shadow, length_);
+            return false;
+        }
+        data_ = static_cast<uint8_t*>(user);
+        shadow_ = static_cast<uint8_t*>(shadow);
+        states_ = std::vector<std::atomic<uint8_t>>(index_.crcs.size());
+        if (register_mapping(this)) return true;
+        munmap(data_, length_); // every slot is taken
+        munmap(shadow_, length_);
+        data_ = shadow_ = nullptr;
+        return false;
+    }
+
+    void close() {
+        if (!data_) return;
+        unregister_mapping(this);
+        munmap(data_, length_);
+        munmap(shadow_, length_);
+        data_ = shadow_ = nullptr;
+    }
+
+    // Readable view of the file. Bytes become accessible as their block is verified.
+    // Unverified bytes passed to a system call fail with EFAULT rather than faulting in.
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return length_; }
+
+    size_t verified_blocks() const {
+        size_t n = 0;
+        for (const auto& s : states_) n += (s.load(std::memory_order_relaxed) == VERIFIED);
+        return n;
+    }
+    size_t block_count() const { return states_.size(); }
+
+    // Verifies every block overlapping [offset, offset + len) without faulting.
+    // Returns false if any of them is corrupt (such blocks stay inaccessible)
+    // or if the range starts past the end of the file.
+    bool verify_range(size_t offset, size_t len) {
+        if (offset >= length_) return false;
+        if (len == 0) return true;
+        size_t first = offset / index_.block_size;
+        size_t last = std::min(states_.size() - 1, (offset + len - 1) / index_.block_size);
+        bool ok = true;
+        for (size_t b = first; b <= last; ++b) ok &= verify_block(b);
+        return ok;
+    }
+
+private:
+    // Safe to call from the signal handler: atomics, CRC over the shadow mapping, mprotect.
+    bool verify_block(size_t block) {
+        uint8_t state = states_[block].load(std::memory_order_acquire);
+        if (state != UNVERIFIED) return state == VERIFIED;
+
+        size_t offset = block * index_.block_size;
+        size_t len = std::min<size_t>(index_.block_size, length_ - offset);
+        if (crc32_update(0, shadow_ + offset, len) != index_.crcs[block]) {
+            states_[block].store(CORRUPT, std::memory_order_release);
+            return false;
+        }
+        // Two threads may verify the same block concurrently; both reach the same result.
+        mprotect(data_ + offset, len, PROT_READ);
+        states_[block].store(VERIFIED, std::memory_order_release);
+        return true;
+    }
+
+    // A fixed table of open mappings that the signal handler can scan without locks.
+    static const int kMaxMappings = 16;
+    static std::atomic<LazyVerifiedFile*> mappings_[kMaxMappings];
+    static struct sigaction previous_;
+    static std::atomic<int> open_count_;
+
+    static bool register_mapping(LazyVerifiedFile* f) {
+        if (open_count_.fetch_add(1) == 0) {
+            struct sigaction sa;
+            std::memset(&sa, 0, sizeof(sa));
+            sa.sa_sigaction = &LazyVerifiedFile::on_fault;
+            sa.sa_flags = SA_SIGINFO;
+            sigemptyset(&sa.sa_mask);
+            sigaction(SIGSEGV, &sa, &previous_);
+        }
+        for (auto& slot : mappings_) {
+            LazyVerifiedFile* expected = nullptr;
+            if (slot.compare_exchange_strong(expected, f)) return true;
+        }
+        if (open_count_.fetch_sub(1) == 1) sigaction(SIGSEGV, &previous_, nullptr);
+        return false;
+    }
+
+    static void unregister_mapping(LazyVerifiedFile* f) {
+        for (auto& slot : mappings_) {
+            LazyVerifiedFile* expected = f;
+            slot.compare_exchange_strong(expected, nullptr);
+        }
+        if (open_count_.fetch_sub(1) == 1) sigaction(SIGSEGV, &previous_, nullptr);
+    }
+
+    // Only first reads of unverified blocks are ours. A fault on a verified
+    // block is either a read that raced with another thread verifying it
+    // (retry once) or a write, which the read-only mapping never permits; the
+    // latter and faults outside every mapping go to the previous handler.
+    static void on_fault(int sig, siginfo_t* info, void* context) {
+        static thread_local uint8_t* retried = nullptr; // last address retried after such a race
+        uint8_t* addr = static_cast<uint8_t*>(info->si_addr);
+        for (auto& slot : mappings_) {
+            LazyVerifiedFile* f = slot.load(std::memory_order_acquire);
+            if (!f || addr < f->data_ || addr >= f->data_ + f->length_) continue;
+            size_t block = static_cast<size_t>(addr - f->data_) / f->index_.block_size;
+            uint8_t state = f->states_[block].load(std::memory_order_acquire);
+            if (state == VERIFIED && retried != addr) {
+                retried = addr;
+                return;
+            }
+            if (state == VERIFIED) break;
+            if (!f->verify_block(block)) {
+                f->policy_(f->path_.c_str(), block);
+                abort(); // the policy returned; retrying would fault forever
+            }
+            retried = nullptr;
+            return; // retry the access, now permitted
+        }
+        chain_to_previous(sig, info, context);
+    }
+
+    static void chain_to_previous(int sig, siginfo_t* info, void* context) {
+        if (previous_.sa_flags & SA_SIGINFO) {
+            previous_.sa_sigaction(sig, info, context);
+        } else if (previous_.sa_handler != SIG_DFL && previous_.sa_handler != SIG_IGN) {
+            previous_.sa_handler(sig);
+        } else {
+            signal(sig, SIG_DFL); // a genuine crash: re-raised when the handler returns
+            raise(sig);
+        }
+    }
+
+    std::string path_;
+    CorruptionPolicy policy_ = abort_on_corruption;
+    BlockIndex index_;
+    uint8_t* data_ = nullptr;
+    uint8_t* shadow_ = nullptr;
+    size_t length_ = 0;
+    std::vector<std::atomic<uint8_t>> states_;
+};
+
+std::atomic<LazyVerifiedFile*> LazyVerifiedFile::mappings_[LazyVerifiedFile::kMaxMappings];
+struct sigaction LazyVerifiedFile::previous_;
+std::atomic<int> LazyVerifiedFile::open_count_{0};
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    init_crc32_table();
+    const std::string path = "/tmp/lazy_verified_demo.bin";
+    const uint32_t block_size = 64 * 1024;
+
+    // Produce a 64 MiB data file and its block index.
+    {
+        std::ofstream out(path, std::ios::binary);
+        std::vector<uint8_t> chunk(1 << 20);
+        for (int c = 0; c < 64; ++c) {
+            for (size_t i = 0; i < chunk.size(); ++i) chunk[i] = static_cast<uint8_t>(i * 7 + c);
+            out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+        }
+    }
+    if (!build_block_index(path, block_size)) {
+        std::cout << "ERROR: cannot build block index" << std::endl;
+        return 1;
+    }
+
+    // 1. Open instantly, verify on demand.
+    auto t = std::chrono::steady_clock::now();
+    LazyVerifiedFile file;
+    if (!file.open(path)) {
+        std::cout << "ERROR: cannot open " << path << std::endl;
+        return 1;
+    }
+    std::cout << "[1] Opened " << (file.size() >> 20) << " MiB in " << elapsed_ms(t) << " ms, "
+              << file.verified_blocks() << "/" << file.block_count() << " blocks verified" << std::endl;
+
+    t = std::chrono::steady_clock::now();
+    const uint8_t* p = file.data();
+    unsigned sum = p[0] + p[100] + p[5 * block_size + 3] + p[file.size() - 1];
+    std::cout << "[2] Read 4 bytes (sum " << sum << ") in " << elapsed_ms(t) << " ms, "
+              << file.verified_blocks() << "/" << file.block_count() << " blocks verified" << std::endl;
+
+    t = std::chrono::steady_clock::now();
+    uint32_t full = crc32_update(0, p, file.size());
+    std::cout << "[3] Full scan (crc 0x" << std::hex << full << std::dec << ") in " << elapsed_ms(t) << " ms, "
+              << file.verified_blocks() << "/" << file.block_count() << " blocks verified" << std::endl;
+    file.close();
+
+    // 2. Corrupt one byte on disk, behind the index's back.
+    int fd = open(path.c_str(), O_WRONLY);
+    uint8_t bad = 0xEE;
+    if (fd < 0 || pwrite(fd, &bad, 1, 10 * block_size + 17) != 1) std::cout << "ERROR: cannot corrupt file" << std::endl;
+    if (fd >= 0) ::close(fd);
+
+    LazyVerifiedFile damaged;
+    damaged.open(path);
+    std::cout << "[4] verify_range(block 9):  " << (damaged.verify_range(9 * block_size, block_size) ? "OK" : "CORRUPT") << std::endl;
+    std::cout << "[5] verify_range(block 10): " << (damaged.verify_range(10 * block_size, block_size) ? "OK" : "CORRUPT") << std::endl;
+
+    // 3. Touching a corrupt block through the mapping triggers the policy (abort) instead
+    //    of returning bad data. Do it in a child process so the demo survives.
+    std::cout << "[6] Child process reads from block 11 (corrupt byte placed there too)..." << std::endl;
+    fd = open(path.c_str(), O_WRONLY);
+    if (fd < 0 || pwrite(fd, &bad, 1, 11 * block_size + 1) != 1) std::cout << "ERROR: cannot corrupt file" << std::endl;
+    if (fd >= 0) ::close(fd);
+    pid_t child = fork();
+    if (child == 0) {
+        volatile uint8_t v = damaged.data()[11 * block_size + 1];
+        (void)v;
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    std::cout << "    child " << (WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT
+                                      ? "was aborted before consuming unverified data"
+                                      : "exited normally (UNEXPECTED)") << std::endl;
+
+    damaged.close();
+    unlink(path.c_str());
+    unlink((path + ".crcidx").c_str());
+    return 0;
+}
@@ -0,0 +1,715 @@
+/*
+ * parallel_gzip_verify.cpp
+ * ------------------------
+ * Verifying gzip files and zlib streams on several threads, with the
+ * checksum of the whole uncompressed content put together from the
+ * per-member checksums instead of one serial pass. Link with -lz.
+ *
+ * A deflate stream can only be inflated from its start, and where it ends is
+ * only known once it has been inflated. What can run in parallel is separate
+ * streams: the members of a multi-member gzip file (pigz -i, bgzip, or just
+ * "cat a.gz b.gz") or concatenated zlib streams. Each one carries its own
+ * check value (CRC-32 and length for gzip, Adler-32 for zlib), so each can be
+ * verified on its own.
+ *
+ * 1. Checksums: CRC-32 with PCLMULQDQ folding and Adler-32 with AVX2, table
+ *    and scalar versions as fallbacks. inflate() runs raw (no zlib wrapper),
+ *    so zlib does not compute the checksums a second time.
+ * 2. Combining: crc32_combine(A, B, |B|) = crc(A) * x^(8|B|) mod P ^ crc(B),
+ *    with the power of x computed by squaring (as in zlib), and the
+ *    corresponding arithmetic for Adler-32. The whole file's checksum is
+ *    folded from the members' checksums in member order.
+ * 3. Finding members: BGZF files record each block's size in the gzip extra
+ *    field, so their members are known exactly. Otherwise every offset that
+ *    looks like a member header (1f 8b 08 for gzip, the first stream's two
+ *    header bytes for zlib) is a candidate.
+ * 4. Verification: worker threads inflate candidates in file order. A false
+ *    candidate usually fails within a few bytes. Then one pass chains the
+ *    results: the member at 0 ends at e, the next member must start at e,
+ *    and so on to the end of the file. Boundaries that were not candidates
+ *    are inflated there and then.
+ * 5. Command line: "parallel_gzip_verify <file> [threads]".
+ * 6. Demo: single-member, multi-member, BGZF and concatenated zlib inputs,
+ *    timed against zlib's own serial inflate, then corrupted ones.
+ *
+ * A single-member file still inflates on one thread. Splitting one deflate
+ * stream needs an index of restart points (zran.c), which is a different
+ * tool.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+// 1. Checksums
+// ------------
+// CRC-32 (IEEE, reflected polynomial 0xEDB88320), on the raw register.
+static uint32_t crc32_table[256];
+
+void init_crc32_table() {
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : c >> 1;
+        crc32_table[n] = c;
+    }
+}
+
+uint32_t crc32_raw_table(uint32_t c, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) c = crc32_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c;
+}
+
+#if defined(HAVE_X86_SIMD)
+// Folding as in stream_checksum_filter.cpp: four 128-bit lanes moved forward
+// 64 bytes at a time, folded into one, then Barrett reduction. Needs
+// len >= 64 and a multiple of 16.
+__attribute__((target("pclmul,sse4.1"))) inline __m128i load128(const uint8_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+__attribute__((target("pclmul,sse4.1"))) inline __m128i fold128(__m128i x, __m128i k, __m128i next) {
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+uint32_t crc32_raw_pclmul(uint32_t c, const uint8_t* data, size_t len) {
+    const __m128i k1k2 = _mm_set_epi64x(0x1c6e41596, 0x154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x0ccaa009e, 0x1751997d0);
+    const __m128i k5 = _mm_set_epi64x(0, 0x163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x1f7011641, 0x1db710641);
+    const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+    __m128i x0 = _mm_xor_si128(load128(data), _mm_cvtsi32_si128(static_cast<int>(c)));
+    __m128i x1 = load128(data + 16), x2 = load128(data + 32), x3 = load128(data + 48);
+    data += 64;
+    len -= 64;
+    for (; len >= 64; data += 64, len -= 64) {
+        x0 = fold128(x0, k1k2, load128(data));
+        x1 = fold128(x1, k1k2, load128(data + 16));
+        x2 = fold128(x2, k1k2, load128(data + 32));
+        x3 = fold128(x3, k1k2, load128(data + 48));
+    }
+    x0 = fold128(x0, k3k4, x1);
+    x0 = fold128(x0, k3k4, x2);
+    x0 = fold128(x0, k3k4, x3);
+    for (; len >= 16; data += 16, len -= 16) x0 = fold128(x0, k3k4, load128(data));
+    x0 = _mm_xor_si128(_mm_clmulepi64_si128(x0, k3k4, 0x10), _mm_srli_si128(x0, 8));
+    x0 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x0, mask32), k5, 0x00), _mm_srli_si128(x0, 4));
+    __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), poly, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), poly, 0x00);
+    return static_cast<uint32_t>(_mm_extract_epi32(_mm_xor_si128(x0, t), 1));
+}
+
+static const bool g_use_pclmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+
+// Continues a finished CRC-32 (0 for none) over more data, like zlib's crc32().
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len) {
+    uint32_t c = ~crc;
+#if defined(HAVE_X86_SIMD)
+    if (g_use_pclmul && len >= 64) {
+        size_t bulk = len & ~size_t(15);
+        c = crc32_raw_pclmul(c, data, bulk);
+        data += bulk;
+        len -= bulk;
+    }
+#endif
+    return ~crc32_raw_table(c, data, len);
+}
+
+// Adler-32: s1 = 1 + sum of bytes, s2 = sum of the running s1, both mod 65521.
+const uint32_t kAdlerMod = 65521;
+
+uint32_t adler32_scalar(uint32_t adler, const uint8_t* data, size_t len) {
+    uint32_t s1 = adler & 0xFFFF, s2 = adler >> 16;
+    while (len > 0) {
+        size_t n = std::min<size_t>(len, 5552); // largest n for which s2 cannot overflow
+        len -= n;
+        for (; n > 0; --n) {
+            s1 += *data++;
+            s2 += s1;
+        }
+        s1 %= kAdlerMod;
+        s2 %= kAdlerMod;
+    }
+    return s1 | (s2 << 16);
+}
+
+#if defined(HAVE_X86_SIMD)
+// 32 bytes per step. Over one block d[0..31], starting from s1:
+//   s2 += 32 * s1 + sum (32 - i) * d[i]     s1 += sum d[i]
+// The weighted sum is maddubs against 32..1; the plain sum is sad against
+// zero. The 32 * s1 terms are kept as a running sum of the block sums (prefix)
+// and multiplied out once per round.
+__attribute__((target("avx2")))
+uint32_t adler32_avx2(uint32_t adler, const uint8_t* data, size_t len) {
+    uint64_t s1 = adler & 0xFFFF, s2 = adler >> 16;
+    const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15,
+                                             14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i ones = _mm256_set1_epi16(1);
+    while (len >= 32) {
+        size_t blocks = std::min<size_t>(len / 32, 4096); // keeps the 32-bit weighted lanes from overflowing
+        __m256i sum = _mm256_setzero_si256(), prefix = _mm256_setzero_si256(), weighted = _mm256_setzero_si256();
+        for (size_t b = 0; b < blocks; ++b, data += 32) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            prefix = _mm256_add_epi64(prefix, sum);
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(d, _mm256_setzero_si256()));
+            weighted = _mm256_add_epi32(weighted, _mm256_madd_epi16(_mm256_maddubs_epi16(d, weights), ones));
+        }
+        uint64_t s[4], p[4];
+        uint32_t w[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(s), sum);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), prefix);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(w), weighted);
+        uint64_t wsum = 0;
+        for (uint32_t v : w) wsum += v;
+        s2 += 32 * blocks * s1 + 32 * (p[0] + p[1] + p[2] + p[3]) + wsum;
+        s1 += s[0] + s[1] + s[2] + s[3];
+        s1 %= kAdlerMod;
+        s2 %= kAdlerMod;
+        len -= blocks * 32;
+    }
+    return adler32_scalar(static_cast<uint32_t>(s1 | (s2 << 16)), data, len);
+}
+
+static const bool g_use_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+// Continues an Adler-32 (1 for none), like zlib's adler32().
+uint32_t adler32_update(uint32_t adler, const uint8_t* data, size_t len) {
+#if defined(HAVE_X86_SIMD)
+    if (g_use_avx2) return adler32_avx2(adler, data, len);
+#endif
+    return adler32_scalar(adler, data, len);
+}
+
+// 2. Combining
+// ------------
+// a * b mod P, both reflected polynomials (bit 31 is x^0).
+uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = 1u << 31, p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ 0xEDB88320u : b >> 1;
+    }
+    return p;
+}
+
+// x^(2^k) mod P for k = 0..63, by repeated squaring.
+struct X2nTable {
+    uint32_t t[64];
+    X2nTable() {
+        t[0] = 1u << 30; // x^1
+        for (int k = 1; k < 64; ++k) t[k] = multmodp(t[k - 1], t[k - 1]);
+    }
+};
+
+static const X2nTable kX2n;
+
+// x^(8 * len) mod P: one multiplication per set bit of len.
+uint32_t x8nmodp(uint64_t len) {
+    uint32_t p = 1u << 31; // x^0
+    for (int k = 3; len; len >>= 1, ++k)
+        if (len & 1) p = multmodp(kX2n.t[k], p);
+    return p;
+}
+
+// CRC-32 of A followed by B, from crc(A), crc(B) and |B|.
+uint32_t crc32_combine_(uint32_t crc_a, uint32_t crc_b, uint64_t len_b) {
+    return multmodp(x8nmodp(len_b), crc_a) ^ crc_b;
+}
+
+// Adler-32 of A followed by B: B's bytes each add s1(A) - 1 more to s2.
+uint32_t adler32_combine_(uint32_t adler_a, uint32_t adler_b, uint64_t len_b) {
+    uint64_t a1 = adler_a & 0xFFFF, a2 = adler_a >> 16, b1 = adler_b & 0xFFFF, b2 = adler_b >> 16;
+    uint64_t s1 = (a1 + b1 + kAdlerMod - 1) % kAdlerMod;
+    uint64_t s2 = (a2 + b2 + (len_b % kAdlerMod) * ((a1 + kAdlerMod - 1) % kAdlerMod)) % kAdlerMod;
+    return static_cast<uint32_t>(s1 | (s2 << 16));
+}
+
+// 3. Member headers
+// -----------------
+enum class Format { kGzip, kZlib };
+
+// Length of a gzip member header at p, 0 if there is none. If the header has
+// a BGZF "BC" subfield, *bgzf_size gets the member's total size.
+size_t parse_gzip_header(const uint8_t* p, size_t avail, size_t* bgzf_size = nullptr) {
+    if (avail < 18 || p[0] != 0x1F || p[1] != 0x8B || p[2] != 8 || (p[3] & 0xE0)) return 0;
+    uint8_t flags = p[3];
+    size_t pos = 10;
+    if (flags & 0x04) { // FEXTRA
+        size_t xlen = p[10] | (p[11] << 8);
+        if (12 + xlen > avail) return 0;
+        for (size_t s = 12; s + 4 <= 12 + xlen;) {
+            size_t slen = p[s + 2] | (p[s + 3] << 8);
+            if (s + 4 + slen > 12 + xlen) break; // subfield overruns the extra field
+            if (bgzf_size && p[s] == 'B' && p[s + 1] == 'C' && slen == 2)
+                *bgzf_size = (p[s + 4] | (p[s + 5] << 8)) + 1u; // BSIZE is the member size - 1
+            s += 4 + slen;
+        }
+        pos = 12 + xlen;
+    }
+    for (uint8_t f : {0x08, 0x10}) { // FNAME, FCOMMENT: zero-terminated
+        if (!(flags & f)) continue;
+        const void* end = pos < avail ? std::memchr(p + pos, 0, avail - pos) : nullptr;
+        if (!end) return 0;
+        pos = static_cast<const uint8_t*>(end) - p + 1;
+    }
+    if (flags & 0x02) { // FHCRC: low 16 bits of the CRC-32 of the header so far
+        if (pos + 2 > avail) return 0;
+        if ((crc32_update(0, p, pos) & 0xFFFF) != static_cast<uint32_t>(p[pos] | (p[pos + 1] << 8))) return 0;
+        pos += 2;
+    }
+    return pos < avail ? pos : 0;
+}
+
+bool is_zlib_header(const uint8_t* p, size_t avail) {
+    return avail >= 6 && (p[0] & 0x0F) == 8 && (p[0] >> 4) <= 7 && !(p[1] & 0x20) && ((p[0] << 8) | p[1]) % 31 == 0;
+}
+
+// 4. Verification
+// ---------------
+struct Member {
+    uint64_t offset = 0, end = 0; // compressed extent
+    uint64_t length = 0;          // uncompressed bytes
+    uint32_t check = 0;           // computed CRC-32 (gzip) or Adler-32 (zlib)
+    bool ok = false;
+    const char* error = "not a member";
+};
+
+// Inflates the member at 'offset' and checks its trailer. 'inflater' is a
+// raw-deflate z_stream owned by the calling thread; 'out' its output buffer.
+Member verify_member(const uint8_t* file, size_t size, uint64_t offset, Format format, z_stream& inflater,
+                     std::vector<uint8_t>& out) {
+    Member m;
+    m.offset = offset;
+    const uint8_t* p = file + offset;
+    size_t avail = size - offset;
+    size_t header = format == Format::kGzip ? parse_gzip_header(p, avail) : is_zlib_header(p, avail) ? 2 : 0;
+    if (header == 0) return m;
+
+    inflateReset(&inflater);
+    inflater.next_in = const_cast<Bytef*>(p + header);
+    inflater.avail_in = 0;
+    uint32_t check = format == Format::kGzip ? 0 : 1;
+    int ret;
+    do {
+        // avail_in is 32 bits: members over 4 GiB are fed in chunks.
+        if (inflater.avail_in == 0)
+            inflater.avail_in = static_cast<uInt>(std::min<size_t>(file + size - inflater.next_in, UINT32_MAX));
+        inflater.next_out = out.data();
+        inflater.avail_out = static_cast<uInt>(out.size());
+        ret = inflate(&inflater, Z_NO_FLUSH);
+        size_t produced = out.size() - inflater.avail_out;
+        // Each output chunk goes straight into the running check value.
+        check = format == Format::kGzip ? crc32_update(check, out.data(), produced)
+                                        : adler32_update(check, out.data(), produced);
+        m.length += produced;
+        if (ret == Z_BUF_ERROR && inflater.avail_in == 0 && inflater.next_in == file + size) {
+            m.error = "truncated";
+            return m;
+        }
+    } while (ret == Z_OK || (ret == Z_BUF_ERROR && (inflater.avail_out == 0 || inflater.avail_in == 0)));
+    if (ret != Z_STREAM_END) {
+        m.error = "invalid deflate data";
+        return m;
+    }
+    m.check = check;
+
+    const uint8_t* t = inflater.next_in;
+    size_t trailer = format == Format::kGzip ? 8 : 4;
+    if (static_cast<size_t>(file + size - t) < trailer) {
+        m.error = "truncated trailer";
+        return m;
+    }
+    m.end = static_cast<uint64_t>(t - file) + trailer;
+    if (format == Format::kGzip) {
+        uint32_t crc = t[0] | (t[1] << 8) | (t[2] << 16) | (uint32_t(t[3]) << 24);
+        uint32_t isize = t[4] | (t[5] << 8) | (t[6] << 16) | (uint32_t(t[7]) << 24);
+        m.ok = crc == check && isize == static_cast<uint32_t>(m.length);
+        m.error = crc != check ? "CRC-32 mismatch" : m.ok ? "" : "length mismatch";
+    } else {
+        uint32_t adler = (uint32_t(t[0]) << 24) | (t[1] << 16) | (t[2] << 8) | t[3];
+        m.ok = adler == check;
+        m.error = m.ok ? "" : "Adler-32 mismatch";
+    }
+    return m;
+}
+
+struct VerifyResult {
+    bool ok = false;
+    Format format = Format::kGzip;
+    bool bgzf = false;
+    size_t candidates = 0; // members inflated speculatively
+    std::vector<Member> members;
+    uint64_t length = 0;  // uncompressed bytes in total
+    uint32_t check = 0;   // CRC-32 or Adler-32 of all of them, combined
+    std::string error;    // with the offset of the first bad member
+};
+
+std::vector<uint64_t> find_candidates(const uint8_t* file, size_t size, Format format, bool& bgzf) {
+    std::vector<uint64_t> c;
+    // BGZF: every member says how long it is.
+    size_t block = 0;
+    if (format == Format::kGzip && parse_gzip_header(file, size, &block) && block) {
+        uint64_t off = 0;
+        while (off < size && parse_gzip_header(file + off, size - off, &(block = 0)) && block) {
+            c.push_back(off);
+            off += block;
+        }
+        if (off == size) {
+            bgzf = true;
+            return c;
+        }
+        c.clear();
+    }
+    // Otherwise every header-looking offset.
+    const uint8_t first[2] = {file[0], file[1]};
+    for (const uint8_t* p = file; (p = static_cast<const uint8_t*>(std::memchr(p, first[0], file + size - p)));
+         ++p) {
+        size_t off = static_cast<size_t>(p - file);
+        if (off + 2 <= size && p[1] == first[1] &&
+            (format == Format::kGzip ? parse_gzip_header(p, size - off) != 0 : is_zlib_header(p, size - off)))
+            c.push_back(off);
+    }
+    return c;
+}
+
+VerifyResult verify(const uint8_t* file, size_t size, unsigned threads) {
+    VerifyResult r;
+    if (size >= 2 && file[0] == 0x1F && file[1] == 0x8B) r.format = Format::kGzip;
+    else if (is_zlib_header(file, size)) r.format = Format::kZlib;
+    else {
+        r.error = "not gzip or zlib data";
+        return r;
+    }
+
+    // Speculative pass: every candidate, in file order, on 'threads' workers.
+    std::vector<uint64_t> cand = find_candidates(file, size, r.format, r.bgzf);
+    r.candidates = cand.size();
+    std::vector<Member> done(cand.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        z_stream zs{};
+        inflateInit2(&zs, -15);
+        std::vector<uint8_t> out(256 << 10);
+        for (size_t i; (i = next.fetch_add(1)) < cand.size();)
+            done[i] = verify_member(file, size, cand[i], r.format, zs, out);
+        inflateEnd(&zs);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool) t.join();
+
+    // Chain: each member must start where the previous one ended.
+    z_stream zs{};
+    inflateInit2(&zs, -15);
+    std::vector<uint8_t> out(256 << 10);
+    r.check = r.format == Format::kGzip ? 0 : 1;
+    for (uint64_t off = 0; off < size;) {
+        auto it = std::lower_bound(cand.begin(), cand.end(), off);
+        Member m = it != cand.end() && *it == off ? done[it - cand.begin()]
+                                                  : verify_member(file, size, off, r.format, zs, out);
+        if (!m.ok) {
+            bool garbage = !r.members.empty() && m.end == 0 && std::strcmp(m.error, "not a member") == 0;
+            r.error = garbage ? "trailing garbage at offset " + std::to_string(off)
+                              : std::string(m.error) + " in member at offset " + std::to_string(off);
+            break;
+        }
+        r.check = r.format == Format::kGzip ? crc32_combine_(r.check, m.check, m.length)
+                                            : adler32_combine_(r.check, m.check, m.length);
+        r.length += m.length;
+        r.members.push_back(m);
+        off = m.end;
+    }
+    inflateEnd(&zs);
+    r.ok = r.error.empty();
+    return r;
+}
+
+// zlib on its own, one thread: inflate with automatic header detection,
+// reset at each member end.
+bool zlib_serial_verify(const uint8_t* file, size_t size, uint64_t& length) {
+    z_stream zs{};
+    inflateInit2(&zs, 15 + 32);
+    std::vector<uint8_t> out(256 << 10);
+    zs.next_in = const_cast<Bytef*>(file);
+    zs.avail_in = 0;
+    length = 0;
+    int ret;
+    for (;;) {
+        if (zs.avail_in == 0) zs.avail_in = static_cast<uInt>(std::min<size_t>(file + size - zs.next_in, UINT32_MAX));
+        zs.next_out = out.data();
+        zs.avail_out = static_cast<uInt>(out.size());
+        ret = inflate(&zs, Z_NO_FLUSH);
+        length += out.size() - zs.avail_out;
+        if (ret == Z_STREAM_END) {
+            if (zs.next_in == file + size) break;
+            inflateReset(&zs);
+        } else if (ret != Z_OK) {
+            break;
+        }
+    }
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+// 5. Command line
+// ---------------
+int run_file(const char* path, unsigned threads) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cout << "ERROR: cannot read " << path << std::endl;
+        return 2;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        std::cout << "ERROR: cannot map " << path << std::endl;
+        return 2;
+    }
+    VerifyResult r = verify(static_cast<const uint8_t*>(map), size, threads);
+    std::cout << path << ": " << (r.ok ? "OK" : "FAILED") << ", " << r.members.size()
+              << (r.format == Format::kGzip ? (r.bgzf ? " BGZF blocks" : " gzip members") : " zlib streams") << ", "
+              << r.length << " bytes, " << (r.format == Format::kGzip ? "CRC-32 " : "Adler-32 ") << std::hex
+              << std::setw(8) << std::setfill('0') << r.check << std::dec << std::setfill(' ') << std::endl;
+    if (!r.ok) std::cout << "  " << r.error << std::endl;
+    munmap(map, size);
+    return r.ok ? 0 : 1;
+}
+
+// 6. Demo
+// -------
+uint64_t next_random(uint64_t& x) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    return x;
+}
+
+template <typename Callback>
+double time_ms(Callback cb) {
+    auto t = std::chrono::steady_clock::now();
+    cb();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+// Log-like text: compresses about 4:1, like most of what ends up in archives.
+std::vector<uint8_t> make_text(size_t size, uint64_t seed) {
+    static const char* words[] = {"GET", "POST", "/api/v1/objects", "/static/app.js", "200", "404", "user", "id",
+                                  "bytes", "latency_ms", "cache", "hit", "miss", "region", "eu-west", "us-east"};
+    std::string s;
+    s.reserve(size + 64);
+    uint64_t x = seed;
+    while (s.size() < size) {
+        s += words[next_random(x) % 16];
+        s += next_random(x) % 4 ? ' ' : '=';
+        if (next_random(x) % 3 == 0) s += std::to_string(next_random(x) % 100000);
+        if (next_random(x) % 12 == 0) s += '\n';
+    }
+    return std::vector<uint8_t>(s.begin(), s.begin() + size);
+}
+
+void put32le(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+std::vector<uint8_t> raw_deflate(const uint8_t* data, size_t len) {
+    z_stream zs{};
+    deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    std::vector<uint8_t> out(deflateBound(&zs, len));
+    zs.next_in = const_cast<Bytef*>(data);
+    zs.avail_in = static_cast<uInt>(len);
+    zs.next_out = out.data();
+    zs.avail_out = static_cast<uInt>(out.size());
+    deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+// 'data' cut into 'piece'-sized members (one member if piece == 0).
+std::vector<uint8_t> make_gzip(const std::vector<uint8_t>& data, size_t piece, bool bgzf) {
+    std::vector<uint8_t> out;
+    if (piece == 0) piece = data.size();
+    for (size_t off = 0; off < data.size(); off += piece) {
+        size_t len = std::min(piece, data.size() - off);
+        std::vector<uint8_t> body = raw_deflate(data.data() + off, len);
+        const uint8_t plain[] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 3};
+        const uint8_t extra[] = {0x1F, 0x8B, 8, 4, 0, 0, 0, 0, 0, 3, 6, 0, 'B', 'C', 2, 0};
+        size_t start = out.size();
+        if (bgzf) out.insert(out.end(), extra, extra + sizeof(extra)), out.resize(out.size() + 2);
+        else out.insert(out.end(), plain, plain + sizeof(plain));
+        out.insert(out.end(), body.begin(), body.end());
+        put32le(out, crc32_update(0, data.data() + off, len));
+        put32le(out, static_cast<uint32_t>(len));
+        if (bgzf) {
+            size_t bsize = out.size() - start - 1;
+            out[start + 16] = static_cast<uint8_t>(bsize);
+            out[start + 17] = static_cast<uint8_t>(bsize >> 8);
+        }
+    }
+    return out;
+}
+
+std::vector<uint8_t> make_zlib(const std::vector<uint8_t>& data, size_t piece) {
+    std::vector<uint8_t> out;
+    for (size_t off = 0; off < data.size(); off += piece) {
+        size_t len = std::min(piece, data.size() - off);
+        std::vector<uint8_t> body = raw_deflate(data.data() + off, len);
+        out.push_back(0x78);
+        out.push_back(0x9C);
+        out.insert(out.end(), body.begin(), body.end());
+        uint32_t adler = adler32_update(1, data.data() + off, len);
+        for (int i = 3; i >= 0; --i) out.push_back(static_cast<uint8_t>(adler >> (8 * i)));
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    init_crc32_table();
+    if (argc >= 2) {
+        unsigned threads = argc >= 3 ? std::max(1, std::atoi(argv[2])) : std::thread::hardware_concurrency();
+        return run_file(argv[1], std::max(1u, threads));
+    }
+
+    // [1] Kernels and combine math against zlib.
+    {
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        std::vector<uint8_t> buf(1 << 16);
+        for (uint8_t& b : buf) b = static_cast<uint8_t>(next_random(x));
+        size_t errors = 0;
+        for (int round = 0; round < 3000; ++round) {
+            size_t off = next_random(x) % 64, len = next_random(x) % (round < 1000 ? 200 : buf.size() - 64);
+            size_t split = len ? next_random(x) % len : 0;
+            const uint8_t* p = buf.data() + off;
+            uint32_t crc_a = crc32_update(0, p, split), crc_b = crc32_update(0, p + split, len - split);
+            uint32_t ad_a = adler32_update(1, p, split), ad_b = adler32_update(1, p + split, len - split);
+            errors += crc32_update(crc_a, p + split, len - split) != crc32(0, p, static_cast<uInt>(len));
+            errors += adler32_update(ad_a, p + split, len - split) != adler32(1, p, static_cast<uInt>(len));
+            errors += crc32_combine_(crc_a, crc_b, len - split) != crc32(0, p, static_cast<uInt>(len));
+            errors += adler32_combine_(ad_a, ad_b, len - split) != adler32(1, p, static_cast<uInt>(len));
+        }
+        // Large lengths: combine takes them without touching any data.
+        for (uint64_t len : {uint64_t(1) << 32, (uint64_t(1) << 40) + 12345}) {
+            errors += crc32_combine_(0x12345678, 0x9ABCDEF0, len) !=
+                      static_cast<uint32_t>(crc32_combine64(0x12345678, 0x9ABCDEF0, static_cast<z_off64_t>(len)));
+            errors += adler32_combine_(0x12345678, 0x0ABCDEF0, len) !=
+                      static_cast<uint32_t>(adler32_combine64(0x12345678, 0x0ABCDEF0, static_cast<z_off64_t>(len)));
+        }
+        std::cout << "[1] CRC-32, Adler-32 and their combine against zlib, 12004 checks: " << errors << " errors"
+                  << std::endl;
+        std::vector<uint8_t> big(64 << 20);
+        for (uint8_t& b : big) b = static_cast<uint8_t>(next_random(x));
+        uint32_t sink = 0;
+        double t_crc = time_ms([&] { sink ^= crc32_update(0, big.data(), big.size()); });
+        double t_zcrc = time_ms([&] { sink ^= crc32(0, big.data(), static_cast<uInt>(big.size())); });
+        double t_ad = time_ms([&] { sink ^= adler32_update(1, big.data(), big.size()); });
+        double t_zad = time_ms([&] { sink ^= adler32(1, big.data(), static_cast<uInt>(big.size())); });
+        std::cout << std::fixed << std::setprecision(2) << "    GB/s on 64 MiB: CRC-32 " << big.size() / t_crc / 1e6
+                  << " (zlib " << big.size() / t_zcrc / 1e6 << "), Adler-32 " << big.size() / t_ad / 1e6 << " (zlib "
+                  << big.size() / t_zad / 1e6 << ")" << (sink == 42 ? " " : "") << std::endl;
+    }
+
+    // [2] Verification speed, MB/s of uncompressed data.
+    std::vector<uint8_t> data = make_text(32 << 20, 12345);
+    const uint32_t want_crc = crc32(0, data.data(), static_cast<uInt>(data.size()));
+    const uint32_t want_adler = adler32(1, data.data(), static_cast<uInt>(data.size()));
+    struct Input {
+        const char* name;
+        std::vector<uint8_t> bytes;
+        uint32_t want;
+    };
+    std::vector<Input> inputs;
+    inputs.push_back({"gzip, 1 member", make_gzip(data, 0, false), want_crc});
+    inputs.push_back({"gzip, 1 MiB members", make_gzip(data, 1 << 20, false), want_crc});
+    inputs.push_back({"BGZF, 64 KiB blocks", make_gzip(data, 65280, true), want_crc});
+    inputs.push_back({"zlib, 1 MiB streams", make_zlib(data, 1 << 20), want_adler});
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "[2] Verifying " << data.size() / (1 << 20) << " MiB of text, MB/s (" << hw
+              << " hardware threads)" << std::endl;
+    std::cout << "  " << std::left << std::setw(22) << "input" << std::right << std::setw(11) << "compressed"
+              << std::setw(9) << "members" << std::setw(12) << "candidates" << std::setw(12) << "zlib serial"
+              << std::setw(10) << "1 thread" << std::setw(10) << "4 threads" << "  check" << std::endl;
+    for (const Input& in : inputs) {
+        uint64_t zlen = 0;
+        bool zok = false;
+        VerifyResult r1, r4;
+        double t_zlib = time_ms([&] { zok = zlib_serial_verify(in.bytes.data(), in.bytes.size(), zlen); });
+        double t1 = time_ms([&] { r1 = verify(in.bytes.data(), in.bytes.size(), 1); });
+        double t4 = time_ms([&] { r4 = verify(in.bytes.data(), in.bytes.size(), 4); });
+        bool good = zok && zlen == data.size() && r1.ok && r4.ok && r1.check == in.want && r4.check == in.want &&
+                    r1.length == data.size();
+        std::cout << "  " << std::left << std::setw(22) << in.name << std::right << std::setw(11) << in.bytes.size()
+                  << std::setw(9) << r4.members.size() << std::setw(12) << r4.candidates << std::setprecision(0)
+                  << std::setw(12) << data.size() / t_zlib / 1e3 << std::setw(10) << data.size() / t1 / 1e3
+                  << std::setw(10) << data.size() / t4 / 1e3 << "  " << (good ? "ok" : "MISMATCH") << std::endl;
+    }
+
+    // [3] Damaged files: each must fail, and say where.
+    std::cout << "[3] Damaged copies of the 1 MiB-member gzip file" << std::endl;
+    const std::vector<uint8_t>& good = inputs[1].bytes;
+    VerifyResult ref = verify(good.data(), good.size(), 4);
+    struct Damage {
+        const char* what;
+        std::vector<uint8_t> bytes;
+    };
+    std::vector<Damage> damaged;
+    std::vector<uint8_t> d = good;
+    d[ref.members[5].offset + 5000] ^= 0x10;
+    damaged.push_back({"bit flip in member 5's data", d});
+    d = good;
+    d[ref.members[10].end - 8] ^= 0x01;
+    damaged.push_back({"bit flip in member 10's CRC", d});
+    d = good;
+    d[ref.members[15].end - 2] ^= 0x01;
+    damaged.push_back({"bit flip in member 15's length", d});
+    d = good;
+    d.resize(d.size() - 5);
+    damaged.push_back({"last 5 bytes cut off", d});
+    d = good;
+    d.erase(d.begin() + ref.members[20].offset, d.begin() + ref.members[21].offset);
+    damaged.push_back({"member 20 removed", d});
+    d = good;
+    d.insert(d.end(), {'j', 'u', 'n', 'k'});
+    damaged.push_back({"4 bytes appended", d});
+    for (const Damage& dm : damaged) {
+        VerifyResult r = verify(dm.bytes.data(), dm.bytes.size(), 4);
+        std::cout << "  " << std::left << std::setw(32) << dm.what << std::right
+                  << (r.ok ? (r.check == want_crc ? "NOT DETECTED" : "OK but content CRC differs") : r.error)
+                  << std::endl;
+    }
+
+    /*
+     * The candidate column counts what the speculative pass inflated: for
+     * gzip, the real members plus any "1f 8b 08" that happens to occur inside
+     * compressed data; for BGZF nothing extra. A removed member is not
+     * caught by any member's own check; it shows up only in the combined
+     * CRC-32 of the content, which is what a stored whole-file checksum would
+     * be compared against. On a machine with one core the 4-thread column
+     * matches the 1-thread one; with more cores it scales with the number of
+     * members until inflate saturates memory bandwidth.
+     */
+    return 0;
+}
@@ -0,0 +1,543 @@
+/*
+ * pcap_reader.cpp
+ * ---------------
+ * A zero-copy reader for packet captures (pcap and pcapng) that decodes the
+ * link and IP headers and verifies IP/UDP/TCP checksums, plus the CRC-8 trailer
+ * of our own telemetry frames.
+ *
+ * 1. Zero copy: the capture is mmap()ed and each packet is returned as a view
+ *    (pointer + length) into the mapping; no packet bytes are ever copied.
+ * 2. Header decoding uses the packed-field extraction of bitwise_and.cpp
+ *    section 6, e.g. for the first byte of an IPv4 header:
+ *        version = (b >> 4) & 0x0F;   ihl = b & 0x0F;
+ *    and for the flags/fragment-offset word:
+ *        more_fragments = (w >> 13) & 0x1;   fragment_offset = w & 0x1FFF;
+ * 3. Checksums: the Internet checksum (RFC 1071) is a one's complement sum of
+ *    16-bit words. It can be accumulated 32 bits at a time in a 64-bit register
+ *    and folded at the end, because 2^16 == 1 (mod 2^16 - 1). A packet is valid
+ *    when the sum over the header (or pseudo-header + segment) including the
+ *    stored checksum is 0xFFFF.
+ * 4. Link-layer CRC-8: frames captured with linktype USER0 (147) are our
+ *    telemetry frames, "payload + crc8_checksum(payload)", as in checksums.cpp.
+ * 5. Parallelism: a first pass walks the record headers and collects packet
+ *    views (cheap, headers only); the views are then verified on all cores.
+ *
+ * Usage:
+ *   ./pcap_reader               generate sample captures and read them
+ *   ./pcap_reader <capture>     read a .pcap or .pcapng file
+ *
+ * Note: captures taken on the sending host often show bad TCP/UDP checksums
+ * because checksum computation was offloaded to the NIC.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 1. Memory-mapped file
+// ---------------------
+class MappedFile {
+public:
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const uint8_t*>(p);
+        return true;
+    }
+    ~MappedFile() {
+        if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Unaligned, endian-aware field readers.
+inline uint16_t be16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+inline uint32_t be32(const uint8_t* p) { return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+inline uint32_t rd32(const uint8_t* p, bool swap) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+inline uint16_t rd16(const uint8_t* p, bool swap) {
+    uint16_t v;
+    std::memcpy(&v, p, 2);
+    return swap ? __builtin_bswap16(v) : v;
+}
+
+// 2. Capture parsing (pcap and pcapng)
+// ------------------------------------
+enum LinkType : uint16_t { LINK_ETHERNET = 1, LINK_RAW = 101, LINK_IPV4 = 228, LINK_IPV6 = 229, LINK_USER0 = 147 };
+
+struct PacketView {
+    const uint8_t* data;   // points into the mapping
+    uint32_t caplen;       // bytes present in the capture
+    uint32_t origlen;      // bytes on the wire
+    uint64_t timestamp_ns;
+    uint16_t linktype;
+};
+
+// Returns false if the file is not a capture we understand. Truncated trailing
+// records are ignored, as tcpdump does.
+bool parse_capture(const uint8_t* p, size_t size, std::vector<PacketView>& out) {
+    if (size < 24) return false;
+    uint32_t magic;
+    std::memcpy(&magic, p, 4);
+
+    // Classic pcap: 24-byte global header, then 16-byte record headers.
+    if (magic == 0xA1B2C3D4 || magic == 0xD4C3B2A1 || magic == 0xA1B23C4D || magic == 0x4D3CB2A1) {
+        bool swap = (magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1);
+        bool nanos = (magic == 0xA1B23C4D || magic == 0x4D3CB2A1);
+        uint16_t linktype = static_cast<uint16_t>(rd32(p + 20, swap) & 0xFFFF);
+        size_t off = 24;
+        while (off + 16 <= size) {
+            uint32_t sec = rd32(p + off, swap), frac = rd32(p + off + 4, swap);
+            uint32_t caplen = rd32(p + off + 8, swap), origlen = rd32(p + off + 12, swap);
+            if (off + 16 + caplen > size) break;
+            out.push_back({p + off + 16, caplen, origlen,
+                           sec * 1000000000ull + (nanos ? frac : frac * 1000ull), linktype});
+            off += 16 + caplen;
+        }
+        return true;
+    }
+
+    // pcapng: a sequence of blocks [type, total_length, body..., total_length].
+    if (magic != 0x0A0D0D0A) return false;
+    bool swap = false;
+    struct Interface { uint16_t linktype; uint64_t units_per_sec; };
+    std::vector<Interface> interfaces;
+    size_t off = 0;
+    while (off + 12 <= size) {
+        uint32_t type = rd32(p + off, swap);
+        if (type == 0x0A0D0D0A) { // Section Header: re-learn the byte order
+            uint32_t bom;
+            std::memcpy(&bom, p + off + 8, 4);
+            swap = (bom == 0x4D3C2B1A);
+            interfaces.clear();
+        }
+        uint32_t len = rd32(p + off + 4, swap);
+        if (len < 12 || off + len > size) break;
+        const uint8_t* body = p + off + 8;
+        size_t body_len = len - 12;
+
+        if (type == 1 && body_len >= 8) { // Interface Description
+            Interface itf{rd16(body, swap), 1000000};
+            for (size_t o = 8; o + 4 <= body_len;) { // options: look for if_tsresol (9)
+                uint16_t code = rd16(body + o, swap), olen = rd16(body + o + 2, swap);
+                if (code == 0 || o + 4 + olen > body_len) break;
+                if (code == 9 && olen >= 1) {
+                    // 2^r or 10^r units per second; a power that does not fit
+                    // in 64 bits marks the interface unusable (0).
+                    uint8_t r = body[o + 4];
+                    bool base2 = r & 0x80;
+                    int exp = r & 0x7F;
+                    uint64_t units = 1;
+                    if (exp < (base2 ? 64 : 20))
+                        for (int k = 0; k < exp; ++k) units *= base2 ? 2 : 10;
+                    else
+                        units = 0;
+                    itf.units_per_sec = units;
+                }
+                o += 4 + ((olen + 3u) & ~3u);
+            }
+            interfaces.push_back(itf);
+        } else if (type == 6 && body_len >= 20) { // Enhanced Packet
+            uint32_t ifid = rd32(body, swap);
+            uint64_t ts = (uint64_t(rd32(body + 4, swap)) << 32) | rd32(body + 8, swap);
+            uint32_t caplen = rd32(body + 12, swap), origlen = rd32(body + 16, swap);
+            // body_len >= 20 here, so the subtraction cannot wrap.
+            if (ifid < interfaces.size() && interfaces[ifid].units_per_sec != 0 && caplen <= body_len - 20) {
+                const Interface& itf = interfaces[ifid];
+                // The remainder times 10^9 overflows 64 bits for resolutions finer than 1 ns.
+                uint64_t ns = ts / itf.units_per_sec * 1000000000ull +
+                              static_cast<uint64_t>(static_cast<unsigned __int128>(ts % itf.units_per_sec) *
+                                                    1000000000ull / itf.units_per_sec);
+                out.push_back({body + 20, caplen, origlen, ns, itf.linktype});
+            }
+        } else if (type == 3 && body_len >= 4 && !interfaces.empty()) { // Simple Packet
+            uint32_t origlen = rd32(body, swap);
+            uint32_t caplen = std::min<uint32_t>(origlen, static_cast<uint32_t>(body_len - 4));
+            out.push_back({body + 4, caplen, origlen, 0, interfaces[0].linktype});
+        }
+        off += len;
+    }
+    return true;
+}
+
+// 3. Checksums
+// ------------
+// One's complement sum of the buffer as 16-bit words in memory order, 32 bits at a time.
+uint64_t ones_sum(const uint8_t* p, size_t len, uint64_t acc = 0) {
+    while (len >= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        acc += (w & 0xFFFFFFFF) + (w >> 32); // cannot overflow for any realistic packet size
+        p += 8;
+        len -= 8;
+    }
+    while (len >= 2) {
+        uint16_t w;
+        std::memcpy(&w, p, 2);
+        acc += w;
+        p += 2;
+        len -= 2;
+    }
+    if (len) {
+        uint8_t last[2] = {p[0], 0}; // odd length: pad with a zero byte
+        uint16_t w;
+        std::memcpy(&w, last, 2);
+        acc += w;
+    }
+    return acc;
+}
+
+// Folds the 64-bit accumulator to 16 bits; a correct checksum folds to 0xFFFF.
+uint16_t fold(uint64_t acc) {
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    acc = (acc & 0xFFFF) + (acc >> 16);
+    acc = (acc & 0xFFFF) + (acc >> 16);
+    return static_cast<uint16_t>(acc);
+}
+
+uint8_t crc8_checksum(const uint8_t* data, size_t len) {
+    static uint8_t table[256];
+    static bool init = [] {
+        for (int n = 0; n < 256; ++n) {
+            uint8_t c = static_cast<uint8_t>(n);
+            for (int i = 0; i < 8; ++i) c = (c & 0x80) ? (c << 1) ^ 0x07 : c << 1;
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)init;
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; ++i) crc = table[crc ^ data[i]];
+    return crc;
+}
+
+// 4. Decoding and verification
+// ----------------------------
+struct Stats {
+    uint64_t packets = 0, bytes = 0, truncated = 0, other = 0;
+    uint64_t ipv4 = 0, ipv6 = 0, udp = 0, tcp = 0, fragments = 0;
+    uint64_t ip_ok = 0, ip_bad = 0;
+    uint64_t l4_ok = 0, l4_bad = 0, l4_unchecked = 0;
+    uint64_t crc8_ok = 0, crc8_bad = 0;
+
+    void merge(const Stats& o) {
+        packets += o.packets, bytes += o.bytes, truncated += o.truncated, other += o.other;
+        ipv4 += o.ipv4, ipv6 += o.ipv6, udp += o.udp, tcp += o.tcp, fragments += o.fragments;
+        ip_ok += o.ip_ok, ip_bad += o.ip_bad;
+        l4_ok += o.l4_ok, l4_bad += o.l4_bad, l4_unchecked += o.l4_unchecked;
+        crc8_ok += o.crc8_ok, crc8_bad += o.crc8_bad;
+    }
+};
+
+// UDP/TCP checksum: pseudo-header sum (already accumulated) + the whole segment.
+void verify_l4(uint8_t proto, const uint8_t* seg, size_t seg_len, uint64_t pseudo, bool ipv6, Stats& st) {
+    if (proto == 17) {
+        ++st.udp;
+        if (seg_len < 8) { ++st.l4_unchecked; return; }
+        if (!ipv6 && be16(seg + 6) == 0) { ++st.l4_unchecked; return; } // IPv4 UDP: checksum optional
+    } else if (proto == 6) {
+        ++st.tcp;
+        if (seg_len < 20) { ++st.l4_unchecked; return; }
+    } else {
+        ++st.other;
+        return;
+    }
+    if (fold(ones_sum(seg, seg_len, pseudo)) == 0xFFFF) ++st.l4_ok; else ++st.l4_bad;
+}
+
+void verify_ip(const uint8_t* p, size_t len, bool complete, Stats& st) {
+    if (len < 1) { ++st.other; return; }
+    uint8_t version = (p[0] >> 4) & 0x0F;
+
+    if (version == 4 && len >= 20) {
+        ++st.ipv4;
+        uint8_t ihl = p[0] & 0x0F;                 // header length in 32-bit words
+        size_t header_len = ihl * 4u;
+        uint16_t total_len = be16(p + 2);
+        uint16_t frag = be16(p + 6);
+        bool more_fragments = (frag >> 13) & 0x1;
+        uint16_t fragment_offset = frag & 0x1FFF;
+        uint8_t proto = p[9];
+        if (header_len < 20 || header_len > len) { ++st.ip_bad; return; }
+        if (fold(ones_sum(p, header_len)) == 0xFFFF) ++st.ip_ok; else { ++st.ip_bad; return; }
+
+        if (more_fragments || fragment_offset != 0) { ++st.fragments; return; }
+        if (!complete || total_len > len || total_len < header_len) { ++st.truncated; return; }
+        uint8_t pseudo[12];
+        std::memcpy(pseudo, p + 12, 8);              // source + destination address
+        pseudo[8] = 0;
+        pseudo[9] = proto;
+        uint16_t seg_len = static_cast<uint16_t>(total_len - header_len);
+        pseudo[10] = static_cast<uint8_t>(seg_len >> 8);
+        pseudo[11] = static_cast<uint8_t>(seg_len & 0xFF);
+        verify_l4(proto, p + header_len, seg_len, ones_sum(pseudo, 12), false, st);
+    } else if (version == 6 && len >= 40) {
+        ++st.ipv6;
+        uint16_t payload_len = be16(p + 4);
+        uint8_t next_header = p[6];
+        if (!complete || 40u + payload_len > len) { ++st.truncated; return; }
+        uint8_t pseudo[40];
+        std::memcpy(pseudo, p + 8, 32);              // source + destination address
+        pseudo[32] = pseudo[33] = 0;
+        pseudo[34] = static_cast<uint8_t>(payload_len >> 8);
+        pseudo[35] = static_cast<uint8_t>(payload_len & 0xFF);
+        pseudo[36] = pseudo[37] = pseudo[38] = 0;
+        pseudo[39] = next_header;                    // extension headers are not followed
+        verify_l4(next_header, p + 40, payload_len, ones_sum(pseudo, 40), true, st);
+    } else {
+        ++st.other;
+    }
+}
+
+void verify_packet(const PacketView& pkt, Stats& st) {
+    ++st.packets;
+    st.bytes += pkt.caplen;
+    bool complete = pkt.caplen == pkt.origlen;
+    const uint8_t* p = pkt.data;
+    size_t len = pkt.caplen;
+
+    switch (pkt.linktype) {
+    case LINK_ETHERNET: {
+        if (len < 14) { ++st.truncated; return; }
+        uint16_t ethertype = be16(p + 12);
+        size_t off = 14;
+        while ((ethertype == 0x8100 || ethertype == 0x88A8) && off + 4 <= len) { // VLAN tags
+            uint16_t tci = be16(p + off);
+            uint16_t vlan_id = tci & 0x0FFF;          // [11:0] VLAN id, [15:13] priority
+            (void)vlan_id;
+            ethertype = be16(p + off + 2);
+            off += 4;
+        }
+        if (ethertype == 0x0800 || ethertype == 0x86DD) verify_ip(p + off, len - off, complete, st);
+        else ++st.other;
+        break;
+    }
+    case LINK_RAW: case LINK_IPV4: case LINK_IPV6:
+        verify_ip(p, len, complete, st);
+        break;
+    case LINK_USER0: // telemetry frame: payload followed by its CRC-8
+        if (!complete || len < 2) { ++st.truncated; return; }
+        if (crc8_checksum(p, len - 1) == p[len - 1]) ++st.crc8_ok; else ++st.crc8_bad;
+        break;
+    default:
+        ++st.other;
+    }
+}
+
+// Verifies all packets, splitting the views evenly across threads.
+Stats verify_all(const std::vector<PacketView>& packets, unsigned threads) {
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(packets.size() / 1024 + 1)));
+    std::vector<Stats> partial(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            size_t begin = packets.size() * t / threads, end = packets.size() * (t + 1) / threads;
+            for (size_t i = begin; i < end; ++i) verify_packet(packets[i], partial[t]);
+        });
+    }
+    for (auto& w : workers) w.join();
+    Stats total;
+    for (const Stats& s : partial) total.merge(s);
+    return total;
+}
+
+// 5. Sample capture generator for the demo
+// ----------------------------------------
+void put16(std::vector<uint8_t>& v, size_t off, uint16_t x) { v[off] = x >> 8; v[off + 1] = x & 0xFF; }
+
+uint16_t checksum_field(const uint8_t* p, size_t len, uint64_t acc = 0) {
+    uint16_t native = static_cast<uint16_t>(~fold(ones_sum(p, len, acc)));
+    return __builtin_bswap16(native); // sum was taken in memory (little-endian) order
+}
+
+std::vector<uint8_t> make_ipv4_packet(uint8_t proto, size_t payload, uint32_t seed, bool corrupt) {
+    size_t l4 = proto == 17 ? 8 : 20;
+    std::vector<uint8_t> f(14 + 20 + l4 + payload, 0);
+    put16(f, 12, 0x0800);
+    uint8_t* ip = &f[14];
+    ip[0] = (4 << 4) | 5;                           // version 4, IHL 5 (packed like section 6)
+    put16(f, 16, static_cast<uint16_t>(20 + l4 + payload));
+    ip[8] = 64;
+    ip[9] = proto;
+    uint8_t addrs[8] = {10, 0, 0, 1, 10, 0, static_cast<uint8_t>(seed), 2};
+    std::memcpy(ip + 12, addrs, 8);
+    for (size_t i = 0; i < payload; ++i) f[14 + 20 + l4 + i] = static_cast<uint8_t>(seed * 31 + i);
+    uint8_t* seg = ip + 20;
+    put16(f, 34, 5000);
+    put16(f, 36, 6000);
+    if (proto == 17) put16(f, 38, static_cast<uint16_t>(8 + payload));
+    else seg[12] = 5 << 4;                          // TCP data offset
+    uint8_t pseudo[12] = {0};
+    std::memcpy(pseudo, ip + 12, 8);
+    pseudo[9] = proto;
+    pseudo[10] = static_cast<uint8_t>((l4 + payload) >> 8);
+    pseudo[11] = static_cast<uint8_t>((l4 + payload) & 0xFF);
+    uint16_t l4sum = checksum_field(seg, l4 + payload, ones_sum(pseudo, 12));
+    put16(f, 14 + 20 + (proto == 17 ? 6 : 16), l4sum);
+    put16(f, 24, checksum_field(ip, 20));
+    if (corrupt) f.back() ^= 0x10;                  // flips a payload bit: L4 checksum fails
+    return f;
+}
+
+std::vector<uint8_t> make_ipv6_udp_packet(size_t payload, uint32_t seed) {
+    std::vector<uint8_t> f(14 + 40 + 8 + payload, 0);
+    put16(f, 12, 0x86DD);
+    uint8_t* ip = &f[14];
+    ip[0] = 6 << 4;
+    put16(f, 18, static_cast<uint16_t>(8 + payload));
+    ip[6] = 17;
+    ip[7] = 64;
+    for (int i = 0; i < 32; ++i) ip[8 + i] = static_cast<uint8_t>(i + seed);
+    put16(f, 54, 7000);
+    put16(f, 56, 8000);
+    put16(f, 58, static_cast<uint16_t>(8 + payload));
+    for (size_t i = 0; i < payload; ++i) f[62 + i] = static_cast<uint8_t>(i ^ seed);
+    uint8_t pseudo[40] = {0};
+    std::memcpy(pseudo, ip + 8, 32);
+    pseudo[34] = static_cast<uint8_t>((8 + payload) >> 8);
+    pseudo[35] = static_cast<uint8_t>((8 + payload) & 0xFF);
+    pseudo[39] = 17;
+    put16(f, 60, checksum_field(ip + 40, 8 + payload, ones_sum(pseudo, 40)));
+    return f;
+}
+
+void write_u32(std::ofstream& out, uint32_t v) { out.write(reinterpret_cast<const char*>(&v), 4); }
+void write_u16(std::ofstream& out, uint16_t v) { out.write(reinterpret_cast<const char*>(&v), 2); }
+
+void write_pcap(const std::string& path, uint16_t linktype, const std::vector<std::vector<uint8_t>>& frames) {
+    std::ofstream out(path, std::ios::binary);
+    write_u32(out, 0xA1B2C3D4);
+    write_u16(out, 2);
+    write_u16(out, 4);
+    write_u32(out, 0);
+    write_u32(out, 0);
+    write_u32(out, 65535);
+    write_u32(out, linktype);
+    uint32_t usec = 0;
+    for (const auto& f : frames) {
+        write_u32(out, 1700000000);
+        write_u32(out, usec++);
+        write_u32(out, static_cast<uint32_t>(f.size()));
+        write_u32(out, static_cast<uint32_t>(f.size()));
+        out.write(reinterpret_cast<const char*>(f.data()), static_cast<std::streamsize>(f.size()));
+    }
+}
+
+void write_pcapng(const std::string& path, uint16_t linktype, const std::vector<std::vector<uint8_t>>& frames) {
+    std::ofstream out(path, std::ios::binary);
+    write_u32(out, 0x0A0D0D0A);                      // Section Header Block
+    write_u32(out, 28);
+    write_u32(out, 0x1A2B3C4D);
+    write_u16(out, 1);
+    write_u16(out, 0);
+    write_u32(out, 0xFFFFFFFF);
+    write_u32(out, 0xFFFFFFFF);                      // section length: unknown
+    write_u32(out, 28);
+    write_u32(out, 1);                               // Interface Description Block
+    write_u32(out, 20);
+    write_u16(out, linktype);
+    write_u16(out, 0);
+    write_u32(out, 65535);
+    write_u32(out, 20);
+    for (const auto& f : frames) {                   // Enhanced Packet Blocks
+        uint32_t padded = (static_cast<uint32_t>(f.size()) + 3) & ~3u;
+        write_u32(out, 6);
+        write_u32(out, 32 + padded);
+        write_u32(out, 0);
+        write_u32(out, 0);
+        write_u32(out, 0);
+        write_u32(out, static_cast<uint32_t>(f.size()));
+        write_u32(out, static_cast<uint32_t>(f.size()));
+        out.write(reinterpret_cast<const char*>(f.data()), static_cast<std::streamsize>(f.size()));
+        for (uint32_t i = static_cast<uint32_t>(f.size()); i < padded; ++i) out.put(0);
+        write_u32(out, 32 + padded);
+    }
+}
+
+void report(const std::string& path) {
+    MappedFile file;
+    std::vector<PacketView> packets;
+    auto t = std::chrono::steady_clock::now();
+    if (!file.open(path) || !parse_capture(file.data(), file.size(), packets)) {
+        std::cout << path << ": ERROR: not a readable pcap/pcapng capture" << std::endl;
+        return;
+    }
+    Stats s = verify_all(packets, std::max(1u, std::thread::hardware_concurrency()));
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+    std::cout << path << std::endl
+              << "  packets " << s.packets << " (" << s.bytes << " bytes) in " << std::fixed
+              << std::setprecision(1) << secs * 1000 << " ms, " << s.bytes / secs / 1e9 << " GB/s" << std::endl
+              << "  IPv4 " << s.ipv4 << ", IPv6 " << s.ipv6 << ", UDP " << s.udp << ", TCP " << s.tcp
+              << ", fragments " << s.fragments << ", truncated " << s.truncated << ", other " << s.other << std::endl
+              << "  IPv4 header checksum ok/bad: " << s.ip_ok << "/" << s.ip_bad
+              << ", UDP/TCP checksum ok/bad/unchecked: " << s.l4_ok << "/" << s.l4_bad << "/" << s.l4_unchecked
+              << ", CRC-8 ok/bad: " << s.crc8_ok << "/" << s.crc8_bad << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 2) {
+        report(argv[1]);
+        return 0;
+    }
+
+    // Ethernet capture: IPv4 UDP/TCP and IPv6 UDP, every 100th packet corrupted.
+    std::vector<std::vector<uint8_t>> frames;
+    for (uint32_t i = 0; i < 200000; ++i) {
+        size_t payload = 64 + (i * 37) % 1300;
+        if (i % 3 == 2) frames.push_back(make_ipv6_udp_packet(payload, i));
+        else frames.push_back(make_ipv4_packet(i % 3 == 0 ? 17 : 6, payload, i, i % 100 == 99));
+    }
+    write_pcap("/tmp/sample_ethernet.pcap", LINK_ETHERNET, frames);
+    write_pcapng("/tmp/sample_ethernet.pcapng", LINK_ETHERNET, frames);
+
+    // Telemetry capture: 16-byte payload + CRC-8, every 50th frame corrupted.
+    std::vector<std::vector<uint8_t>> telemetry;
+    for (uint32_t i = 0; i < 10000; ++i) {
+        std::vector<uint8_t> f(17);
+        for (int k = 0; k < 16; ++k) f[k] = static_cast<uint8_t>(i * 7 + k);
+        f[16] = crc8_checksum(f.data(), 16);
+        if (i % 50 == 0) f[3] ^= 0x04;
+        telemetry.push_back(f);
+    }
+    write_pcap("/tmp/sample_telemetry.pcap", LINK_USER0, telemetry);
+
+    report("/tmp/sample_ethernet.pcap");
+    report("/tmp/sample_ethernet.pcapng");
+    report("/tmp/sample_telemetry.pcap");
+
+    std::remove("/tmp/sample_ethernet.pcap");
+    std::remove("/tmp/sample_ethernet.pcapng");
+    std::remove("/tmp/sample_telemetry.pcap");
+    return 0;
+}
@@ -0,0 +1,304 @@
+/*
+ * range_checksums.cpp
+ * -------------------
+ * O(1) / O(log n) checksum queries over arbitrary subranges of an immutable buffer.
+ *
+ * xor_checksum and sum_checksum (see checksums.cpp) rescan the whole range on
+ * every call. When the same large buffer is queried many times it pays to
+ * precompute prefix values once:
+ *
+ *   P[i] = data[0] op data[1] op ... op data[i-1]     (P[0] = identity)
+ *
+ * 1. Range XOR:   xor(l, r) = P[r] ^ P[l]              (XOR is its own inverse)
+ * 2. Range sum:   sum(l, r) = P[r] - P[l]  (mod 256)   (subtraction undoes addition)
+ * 3. Range CRC-8: CRC is linear over GF(2), so for the CRC of data[l..r):
+ *                 crc(l, r) = P[r] ^ (P[l] * x^(8*(r-l)) mod poly)
+ *    Removing the prefix means "shifting" its CRC past r-l bytes, which is done
+ *    with square-and-multiply in O(log n).
+ *
+ * The XOR and sum prefixes are built with a vectorized parallel scan: each
+ * 16-byte SSE register is scanned in log2(16) = 4 shift+op steps, and large
+ * buffers are split across threads (local scan, then a fix-up pass that adds
+ * each chunk's carry-in).
+ *
+ * Every prefix array stores one byte per input byte, the same width as the
+ * 8-bit checksums it answers.
+ */
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include <cstdint>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Reference implementations (same as checksums.cpp), used to verify the index.
+uint8_t sum_checksum(const std::vector<uint8_t>& data) {
+    uint32_t sum = 0;
+    for (uint8_t byte : data) sum += byte;
+    return static_cast<uint8_t>(sum & 0xFF);
+}
+
+uint8_t xor_checksum(const std::vector<uint8_t>& data) {
+    uint8_t result = 0;
+    for (uint8_t byte : data) result ^= byte;
+    return result;
+}
+
+uint8_t crc8_checksum(const std::vector<uint8_t>& data) {
+    uint8_t crc = 0x00;
+    for (uint8_t byte : data) {
+        crc ^= byte;
+        for (int i = 0; i < 8; ++i)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+// 1. Scan operators
+// -----------------
+// The scan is written once and instantiated for XOR and for (wrapping) byte addition.
+struct XorOp {
+    static uint8_t apply(uint8_t a, uint8_t b) { return a ^ b; }
+#if defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+#endif
+};
+
+struct AddOp {
+    static uint8_t apply(uint8_t a, uint8_t b) { return static_cast<uint8_t>(a + b); }
+#if defined(__SSE2__)
+    static __m128i apply(__m128i a, __m128i b) { return _mm_add_epi8(a, b); }
+#endif
+};
+
+// 2. Vectorized inclusive scan of one contiguous chunk
+// ----------------------------------------------------
+// Writes out[i] = carry op in[0] op ... op in[i] and returns the last value.
+// Inside a register: x = x op (x << 1 byte), then << 2, << 4, << 8 bytes. After
+// the four steps lane k holds the combination of lanes 0..k.
+template <typename Op>
+uint8_t scan_chunk(const uint8_t* in, uint8_t* out, size_t n, uint8_t carry) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128i running = _mm_set1_epi8(static_cast<char>(carry));
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        x = Op::apply(x, _mm_slli_si128(x, 1));
+        x = Op::apply(x, _mm_slli_si128(x, 2));
+        x = Op::apply(x, _mm_slli_si128(x, 4));
+        x = Op::apply(x, _mm_slli_si128(x, 8));
+        x = Op::apply(x, running);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), x);
+        // Broadcast lane 15 (the register's total) as the carry for the next block.
+        running = _mm_set1_epi8(static_cast<char>(_mm_extract_epi16(x, 7) >> 8));
+    }
+    carry = static_cast<uint8_t>(_mm_cvtsi128_si32(running));
+#endif
+    for (; i < n; ++i) {
+        carry = Op::apply(carry, in[i]);
+        out[i] = carry;
+    }
+    return carry;
+}
+
+// Combine a constant carry-in into an already scanned chunk (the fix-up pass).
+template <typename Op>
+void apply_carry(uint8_t* out, size_t n, uint8_t carry) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128i c = _mm_set1_epi8(static_cast<char>(carry));
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), Op::apply(x, c));
+    }
+#endif
+    for (; i < n; ++i) out[i] = Op::apply(out[i], carry);
+}
+
+// 3. Multi-threaded prefix build
+// ------------------------------
+// prefix has n + 1 entries; prefix[0] = 0 is the identity for both XOR and addition.
+template <typename Op>
+void build_prefix(const std::vector<uint8_t>& data, std::vector<uint8_t>& prefix) {
+    const size_t n = data.size();
+    prefix.assign(n + 1, 0);
+    uint8_t* out = prefix.data() + 1;
+
+    size_t threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    if (n < (size_t(1) << 20)) threads = 1; // not worth spawning threads for small buffers
+
+    size_t chunk = (n + threads - 1) / threads;
+    std::vector<uint8_t> totals(threads, 0);
+    std::vector<std::thread> workers;
+
+    // Pass 1: every chunk scans independently starting from the identity.
+    for (size_t t = 0; t < threads; ++t) {
+        size_t begin = std::min(n, t * chunk), end = std::min(n, begin + chunk);
+        workers.emplace_back([&, t, begin, end] {
+            totals[t] = scan_chunk<Op>(data.data() + begin, out + begin, end - begin, 0);
+        });
+    }
+    for (auto& w : workers) w.join();
+    workers.clear();
+
+    // Pass 2: each chunk needs the combined total of all chunks before it.
+    uint8_t carry = 0;
+    for (size_t t = 0; t < threads; ++t) {
+        size_t begin = std::min(n, t * chunk), end = std::min(n, begin + chunk);
+        if (carry != 0)
+            workers.emplace_back([=] { apply_carry<Op>(out + begin, end - begin, carry); });
+        carry = Op::apply(carry, totals[t]);
+    }
+    for (auto& w : workers) w.join();
+}
+
+// 4. CRC-8 shift arithmetic
+// -------------------------
+// CRC-8 (poly 0x07, init 0) of A followed by B equals crc(B) ^ shift(crc(A), |B|),
+// where shift multiplies by x^(8*|B|) modulo the generator x^8 + x^2 + x + 1.
+static uint8_t crc8_table[256];
+
+void init_crc8_table() {
+    for (int n = 0; n < 256; ++n) {
+        uint8_t c = static_cast<uint8_t>(n);
+        for (int i = 0; i < 8; ++i)
+            c = (c & 0x80) ? (c << 1) ^ 0x07 : c << 1;
+        crc8_table[n] = c;
+    }
+}
+
+// Carry-less multiply of two degree < 8 polynomials, reduced modulo 0x107.
+uint8_t gf_mul(uint8_t a, uint8_t b) {
+    uint8_t result = 0;
+    for (int i = 0; i < 8; ++i) {
+        if (b & 1) result ^= a;
+        b >>= 1;
+        a = (a & 0x80) ? (a << 1) ^ 0x07 : a << 1; // a *= x
+    }
+    return result;
+}
+
+// x^(8 * 2^k) mod poly for k = 0..63, so any shift is a product of at most 64 factors.
+static uint8_t shift_powers[64];
+
+void init_shift_powers() {
+    shift_powers[0] = crc8_table[1]; // x^8 mod poly == 0x07
+    for (int k = 1; k < 64; ++k)
+        shift_powers[k] = gf_mul(shift_powers[k - 1], shift_powers[k - 1]);
+}
+
+// crc * x^(8 * bytes) mod poly, in O(log bytes) multiplications.
+uint8_t crc8_shift(uint8_t crc, uint64_t bytes) {
+    for (int k = 0; bytes != 0 && crc != 0; ++k, bytes >>= 1)
+        if (bytes & 1) crc = gf_mul(crc, shift_powers[k]);
+    return crc;
+}
+
+// 5. The index
+// ------------
+// Queries use half-open ranges [l, r) with l <= r <= size().
+class RangeChecksumIndex {
+public:
+    explicit RangeChecksumIndex(const std::vector<uint8_t>& data) {
+        build_prefix<XorOp>(data, prefix_xor_);
+        build_prefix<AddOp>(data, prefix_sum_);
+
+        // CRC prefixes are inherently sequential: one table lookup per byte.
+        prefix_crc_.assign(data.size() + 1, 0);
+        uint8_t crc = 0;
+        for (size_t i = 0; i < data.size(); ++i) {
+            crc = crc8_table[crc ^ data[i]];
+            prefix_crc_[i + 1] = crc;
+        }
+    }
+
+    size_t size() const { return prefix_xor_.size() - 1; }
+
+    uint8_t range_xor(size_t l, size_t r) const { return prefix_xor_[r] ^ prefix_xor_[l]; }
+
+    uint8_t range_sum(size_t l, size_t r) const {
+        return static_cast<uint8_t>(prefix_sum_[r] - prefix_sum_[l]);
+    }
+
+    uint8_t range_crc8(size_t l, size_t r) const {
+        return prefix_crc_[r] ^ crc8_shift(prefix_crc_[l], r - l);
+    }
+
+private:
+    std::vector<uint8_t> prefix_xor_;
+    std::vector<uint8_t> prefix_sum_;
+    std::vector<uint8_t> prefix_crc_;
+};
+
+int main() {
+    init_crc8_table();
+    init_shift_powers();
+
+    // Pseudo-random test buffer (xorshift32)
+    const size_t size = 64u << 20; // 64 MiB
+    std::vector<uint8_t> data(size);
+    uint32_t x = 2463534242u;
+    for (auto& byte : data) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        byte = static_cast<uint8_t>(x);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    RangeChecksumIndex index(data);
+    auto t1 = std::chrono::steady_clock::now();
+    std::cout << "Built index over " << (size >> 20) << " MiB in "
+              << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms" << std::endl;
+
+    // 1. Correctness: compare against the rescanning checksums on random ranges.
+    int mismatches = 0;
+    for (int q = 0; q < 200; ++q) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        size_t l = x % size;
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        size_t r = l + x % std::min<size_t>(size - l + 1, 100000);
+        std::vector<uint8_t> slice(data.begin() + l, data.begin() + r);
+        if (index.range_xor(l, r) != xor_checksum(slice)) ++mismatches;
+        if (index.range_sum(l, r) != sum_checksum(slice)) ++mismatches;
+        if (index.range_crc8(l, r) != crc8_checksum(slice)) ++mismatches;
+    }
+    std::cout << "Checked 200 random ranges against xor/sum/crc8_checksum: "
+              << (mismatches == 0 ? "all match" : "MISMATCHES FOUND") << std::endl;
+
+    // Example query on the sample data from checksums.cpp
+    std::vector<uint8_t> sample = {0x10, 0x20, 0x30, 0x40, 0x55, 0xAA, 0xFF};
+    RangeChecksumIndex small(sample);
+    std::cout << std::hex << "Sample [0,7): sum=0x" << (int)small.range_sum(0, 7)
+              << " xor=0x" << (int)small.range_xor(0, 7)
+              << " crc8=0x" << (int)small.range_crc8(0, 7)
+              << "   [2,5): crc8=0x" << (int)small.range_crc8(2, 5) << std::dec << std::endl;
+
+    // 2. Throughput: one million whole-buffer-sized queries would take hours by rescanning.
+    const int queries = 1000000;
+    uint32_t acc = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        size_t l = x % (size / 2), r = l + size / 2;
+        acc += index.range_xor(l, r) + index.range_sum(l, r) + index.range_crc8(l, r);
+    }
+    t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / queries;
+    std::cout << "Indexed query (xor+sum+crc8 over 32 MiB ranges): " << std::fixed
+              << std::setprecision(1) << ns << " ns/query (checksum accumulator " << acc % 256 << ")" << std::endl;
+
+    std::vector<uint8_t> half(data.begin(), data.begin() + size / 2);
+    t0 = std::chrono::steady_clock::now();
+    uint8_t rescanned = xor_checksum(half) ^ sum_checksum(half) ^ crc8_checksum(half);
+    t1 = std::chrono::steady_clock::now();
+    std::cout << "Rescanning the same 32 MiB range once: "
+              << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms (result 0x"
+              << std::hex << (int)rescanned << std::dec << ")" << std::endl;
+
+    return 0;
+}
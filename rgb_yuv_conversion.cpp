@@ -0,0 +1,461 @@
+/*
+ * rgb_yuv_conversion.cpp
+ * ----------------------
+ * Converting packed ARGB pixels to YUV (and back) with fixed-point SIMD.
+ *
+ * Section 1 of bitwise_and.cpp extracts the channels of one 0xAARRGGBB pixel:
+ *     blue = color & 0xFF;  green = (color >> 8) & 0xFF;  red = (color >> 16) & 0xFF;
+ * Video encoders want the same pixels as YUV: a luma plane Y (brightness) and
+ * two chroma planes U, V (colour differences):
+ *     Y = Kr*R + Kg*G + Kb*B          (Kg = 1 - Kr - Kb)
+ *     U = (B - Y) / (2 * (1 - Kb))
+ *     V = (R - Y) / (2 * (1 - Kr))
+ * BT.601 (SD) uses Kr = 0.299, Kb = 0.114; BT.709 (HD) uses Kr = 0.2126, Kb = 0.0722.
+ * Here the "limited range" encoding is used: Y in 16..235, U/V in 16..240.
+ *
+ * 1. Fixed point: coefficients are scaled by 2^14 and rounded to integers; the
+ *    result is (sum + 2^13) >> 14, i.e. rounded to nearest, with no floats at all.
+ * 2. SIMD (AVX2, 8 pixels per register): the same masks as section 1, but on a
+ *    whole register. (p & 0x00FF00FF) leaves 16-bit lanes [B, R] and
+ *    ((p >> 8) & 0x00FF00FF) leaves [G, A]; one pmaddwd against [cb, cr] and one
+ *    against [cg, 0] give the 32-bit weighted sum for every pixel.
+ * 3. Formats: 4:4:4 (one U/V per pixel), 4:2:0 (one U/V per 2x2 block, from the
+ *    rounded average of the four pixels), luma only (grayscale), and the inverse
+ *    conversions back to ARGB.
+ * 4. Multi-threading: the image is split into horizontal slices, one per thread.
+ *
+ * Scalar fixed-point kernels give bit-identical results and are used when AVX2
+ * is unavailable; a float reference is used to check accuracy.
+ */
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+// 1. Conversion matrices in fixed point
+// -------------------------------------
+struct YuvMatrix {
+    const char* name;
+    double kr, kb;
+    // RGB -> YUV, Q14
+    int16_t yr, yg, yb, ur, ug, ub, vr, vg, vb;
+    // YUV -> RGB, Q13
+    int32_t cy, rv, gu, gv, bu;
+};
+
+YuvMatrix make_matrix(const char* name, double kr, double kb) {
+    const double kg = 1.0 - kr - kb;
+    const double ys = 219.0 / 255.0, cs = 224.0 / 255.0; // limited-range scale factors
+    auto q14 = [](double v) { return static_cast<int16_t>(std::lround(v * 16384.0)); };
+    auto q13 = [](double v) { return static_cast<int32_t>(std::lround(v * 8192.0)); };
+
+    YuvMatrix m;
+    m.name = name;
+    m.kr = kr;
+    m.kb = kb;
+    m.yr = q14(ys * kr);
+    m.yb = q14(ys * kb);
+    m.yg = static_cast<int16_t>(q14(ys) - m.yr - m.yb);  // rows sum exactly: white stays white
+    m.ub = q14(cs * 0.5);
+    m.ur = q14(-cs * 0.5 * kr / (1 - kb));
+    m.ug = static_cast<int16_t>(-m.ub - m.ur);           // gray has no chroma
+    m.vr = q14(cs * 0.5);
+    m.vb = q14(-cs * 0.5 * kb / (1 - kr));
+    m.vg = static_cast<int16_t>(-m.vr - m.vb);
+
+    m.cy = q13(1.0 / ys);
+    m.rv = q13(2 * (1 - kr) / cs);
+    m.bu = q13(2 * (1 - kb) / cs);
+    m.gu = q13(-2 * (1 - kb) * kb / kg / cs);
+    m.gv = q13(-2 * (1 - kr) * kr / kg / cs);
+    return m;
+}
+
+const YuvMatrix BT601 = make_matrix("BT.601", 0.299, 0.114);
+const YuvMatrix BT709 = make_matrix("BT.709", 0.2126, 0.0722);
+
+const int32_t kYOffset = (16 << 14) + (1 << 13);  // +16, then round to nearest
+const int32_t kCOffset = (128 << 14) + (1 << 13); // +128, then round to nearest
+
+struct YuvImage {
+    int width = 0, height = 0;
+    int chroma_width = 0, chroma_height = 0;
+    std::vector<uint8_t> y, u, v;
+
+    void allocate(int w, int h, bool subsampled) {
+        width = w;
+        height = h;
+        chroma_width = subsampled ? (w + 1) / 2 : w;
+        chroma_height = subsampled ? (h + 1) / 2 : h;
+        y.assign(static_cast<size_t>(w) * h, 0);
+        u.assign(static_cast<size_t>(chroma_width) * chroma_height, 0);
+        v.assign(u.size(), 0);
+    }
+};
+
+// 2. Scalar fixed-point kernels (one row each)
+// --------------------------------------------
+inline uint8_t clamp_u8(int32_t v) { return static_cast<uint8_t>(v < 0 ? 0 : v > 255 ? 255 : v); }
+
+void rgb_to_yuv444_row_scalar(const uint32_t* px, uint8_t* y, uint8_t* u, uint8_t* v, int n, const YuvMatrix& m) {
+    for (int i = 0; i < n; ++i) {
+        int32_t b = px[i] & 0xFF, g = (px[i] >> 8) & 0xFF, r = (px[i] >> 16) & 0xFF;
+        y[i] = static_cast<uint8_t>((m.yr * r + m.yg * g + m.yb * b + kYOffset) >> 14);
+        if (u) u[i] = static_cast<uint8_t>((m.ur * r + m.ug * g + m.ub * b + kCOffset) >> 14);
+        if (v) v[i] = static_cast<uint8_t>((m.vr * r + m.vg * g + m.vb * b + kCOffset) >> 14);
+    }
+}
+
+// One chroma row of 4:2:0 from two pixel rows. Each channel is averaged over the
+// 2x2 block with rounding, (sum + 2) >> 2, before the chroma matrix is applied.
+void rgb_to_chroma420_row_scalar(const uint32_t* row0, const uint32_t* row1, uint8_t* u, uint8_t* v,
+                                 int width, const YuvMatrix& m) {
+    for (int cx = 0; cx < (width + 1) / 2; ++cx) {
+        int x0 = 2 * cx, x1 = std::min(2 * cx + 1, width - 1);
+        uint32_t p[4] = {row0[x0], row0[x1], row1[x0], row1[x1]};
+        int32_t b = 2, g = 2, r = 2;
+        for (uint32_t q : p) {
+            b += q & 0xFF;
+            g += (q >> 8) & 0xFF;
+            r += (q >> 16) & 0xFF;
+        }
+        b >>= 2; g >>= 2; r >>= 2;
+        u[cx] = static_cast<uint8_t>((m.ur * r + m.ug * g + m.ub * b + kCOffset) >> 14);
+        v[cx] = static_cast<uint8_t>((m.vr * r + m.vg * g + m.vb * b + kCOffset) >> 14);
+    }
+}
+
+// 'chroma_shift' is 1 for 4:2:0 rows (each U/V sample covers two pixels), 0 for 4:4:4.
+void yuv_to_rgb_row_scalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* px, int n,
+                           int chroma_shift, const YuvMatrix& m) {
+    for (int i = 0; i < n; ++i) {
+        int32_t yy = (y[i] - 16) * m.cy + (1 << 12);
+        int32_t uu = u[i >> chroma_shift] - 128, vv = v[i >> chroma_shift] - 128;
+        int32_t r = (yy + m.rv * vv) >> 13;
+        int32_t g = (yy + m.gu * uu + m.gv * vv) >> 13;
+        int32_t b = (yy + m.bu * uu) >> 13;
+        px[i] = 0xFF000000u | (uint32_t(clamp_u8(r)) << 16) | (uint32_t(clamp_u8(g)) << 8) | clamp_u8(b);
+    }
+}
+
+#if defined(HAVE_X86_SIMD)
+// 3. AVX2 kernels, 8 pixels per iteration
+// ---------------------------------------
+// Packs a pair of int16 coefficients into each 32-bit lane: low half * first
+// 16-bit input + high half * second 16-bit input, as consumed by pmaddwd.
+__attribute__((target("avx2")))
+static inline __m256i coef_pair(int16_t lo, int16_t hi) {
+    return _mm256_set1_epi32(static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(hi)) << 16) |
+                                                  static_cast<uint16_t>(lo)));
+}
+
+// Weighted sum of B, G, R for 8 pixels whose channels are already split into
+// [B, R] and [G, A] 16-bit lane pairs, plus offset, >> 14, as 32-bit lanes.
+__attribute__((target("avx2")))
+static inline __m256i weigh(__m256i br, __m256i ga, __m256i c_br, __m256i c_g, __m256i offset) {
+    __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(br, c_br), _mm256_madd_epi16(ga, c_g));
+    return _mm256_srai_epi32(_mm256_add_epi32(sum, offset), 14);
+}
+
+// Packs the low byte of each 32-bit lane of 'a' into 8 consecutive bytes.
+__attribute__((target("avx2")))
+static inline void store_8_bytes(uint8_t* out, __m256i a) {
+    __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(a, a), _mm256_setzero_si256());
+    packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(packed));
+}
+
+__attribute__((target("avx2")))
+void rgb_to_yuv444_row_avx2(const uint32_t* px, uint8_t* y, uint8_t* u, uint8_t* v, int n, const YuvMatrix& m) {
+    const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i y_br = coef_pair(m.yb, m.yr), y_g = coef_pair(m.yg, 0);
+    const __m256i u_br = coef_pair(m.ub, m.ur), u_g = coef_pair(m.ug, 0);
+    const __m256i v_br = coef_pair(m.vb, m.vr), v_g = coef_pair(m.vg, 0);
+    const __m256i y_off = _mm256_set1_epi32(kYOffset), c_off = _mm256_set1_epi32(kCOffset);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(px + i));
+        __m256i br = _mm256_and_si256(p, mask);                       // [B, R] like "color & 0xFF"
+        __m256i ga = _mm256_and_si256(_mm256_srli_epi32(p, 8), mask); // [G, A] like "(color >> 8) & 0xFF"
+        store_8_bytes(y + i, weigh(br, ga, y_br, y_g, y_off));
+        if (u) store_8_bytes(u + i, weigh(br, ga, u_br, u_g, c_off));
+        if (v) store_8_bytes(v + i, weigh(br, ga, v_br, v_g, c_off));
+    }
+    rgb_to_yuv444_row_scalar(px + i, y + i, u ? u + i : nullptr, v ? v + i : nullptr, n - i, m);
+}
+
+__attribute__((target("avx2")))
+void rgb_to_chroma420_row_avx2(const uint32_t* row0, const uint32_t* row1, uint8_t* u, uint8_t* v,
+                               int width, const YuvMatrix& m) {
+    const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i two = _mm256_set1_epi16(2);
+    const __m256i u_br = coef_pair(m.ub, m.ur), u_g = coef_pair(m.ug, 0);
+    const __m256i v_br = coef_pair(m.vb, m.vr), v_g = coef_pair(m.vg, 0);
+    const __m256i c_off = _mm256_set1_epi32(kCOffset);
+    const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    int cx = 0;
+    // 16 pixels of each row -> 8 chroma samples.
+    for (; 2 * cx + 16 <= width; cx += 8) {
+        const uint32_t* a = row0 + 2 * cx;
+        const uint32_t* b = row1 + 2 * cx;
+        __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + 8));
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 8));
+        // Vertical sums per 16-bit channel (max 510, so no carry between halves).
+        __m256i br0 = _mm256_add_epi16(_mm256_and_si256(a0, mask), _mm256_and_si256(b0, mask));
+        __m256i br1 = _mm256_add_epi16(_mm256_and_si256(a1, mask), _mm256_and_si256(b1, mask));
+        __m256i ga0 = _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi32(a0, 8), mask),
+                                       _mm256_and_si256(_mm256_srli_epi32(b0, 8), mask));
+        __m256i ga1 = _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi32(a1, 8), mask),
+                                       _mm256_and_si256(_mm256_srli_epi32(b1, 8), mask));
+        // Horizontal pairs: hadd works within 128-bit halves, so restore pixel order after.
+        __m256i br = _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(br0, br1), order);
+        __m256i ga = _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(ga0, ga1), order);
+        br = _mm256_srli_epi16(_mm256_add_epi16(br, two), 2); // rounded 2x2 average
+        ga = _mm256_srli_epi16(_mm256_add_epi16(ga, two), 2);
+        store_8_bytes(u + cx, weigh(br, ga, u_br, u_g, c_off));
+        store_8_bytes(v + cx, weigh(br, ga, v_br, v_g, c_off));
+    }
+    rgb_to_chroma420_row_scalar(row0 + 2 * cx, row1 + 2 * cx, u + cx, v + cx, width - 2 * cx, m);
+}
+
+__attribute__((target("avx2")))
+void yuv_to_rgb_row_avx2(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* px, int n,
+                         int chroma_shift, const YuvMatrix& m) {
+    const __m256i c16 = _mm256_set1_epi32(16), c128 = _mm256_set1_epi32(128);
+    const __m256i cy = _mm256_set1_epi32(m.cy), rv = _mm256_set1_epi32(m.rv), bu = _mm256_set1_epi32(m.bu);
+    const __m256i gu = _mm256_set1_epi32(m.gu), gv = _mm256_set1_epi32(m.gv);
+    const __m256i round = _mm256_set1_epi32(1 << 12), zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi32(255), alpha = _mm256_set1_epi32(static_cast<int32_t>(0xFF000000u));
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i yy = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i)));
+        __m128i u8, v8;
+        if (chroma_shift) {
+            // 4 chroma samples, each duplicated for two neighbouring pixels.
+            int32_t u4, v4;
+            std::memcpy(&u4, u + (i >> 1), 4);
+            std::memcpy(&v4, v + (i >> 1), 4);
+            u8 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(u4), _mm_cvtsi32_si128(u4));
+            v8 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v4), _mm_cvtsi32_si128(v4));
+        } else {
+            u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + i));
+            v8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + i));
+        }
+        __m256i uu = _mm256_sub_epi32(_mm256_cvtepu8_epi32(u8), c128);
+        __m256i vv = _mm256_sub_epi32(_mm256_cvtepu8_epi32(v8), c128);
+        yy = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(yy, c16), cy), round);
+        __m256i r = _mm256_srai_epi32(_mm256_add_epi32(yy, _mm256_mullo_epi32(vv, rv)), 13);
+        __m256i g = _mm256_srai_epi32(_mm256_add_epi32(yy, _mm256_add_epi32(_mm256_mullo_epi32(uu, gu),
+                                                                             _mm256_mullo_epi32(vv, gv))), 13);
+        __m256i b = _mm256_srai_epi32(_mm256_add_epi32(yy, _mm256_mullo_epi32(uu, bu)), 13);
+        r = _mm256_min_epi32(_mm256_max_epi32(r, zero), max);
+        g = _mm256_min_epi32(_mm256_max_epi32(g, zero), max);
+        b = _mm256_min_epi32(_mm256_max_epi32(b, zero), max);
+        // Reassemble 0xAARRGGBB, the inverse of section 1's extraction.
+        __m256i p = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(r, 16)),
+                                    _mm256_or_si256(_mm256_slli_epi32(g, 8), b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(px + i), p);
+    }
+    yuv_to_rgb_row_scalar(y + i, u + (i >> chroma_shift), v + (i >> chroma_shift), px + i, n - i, chroma_shift, m);
+}
+#endif
+
+// Row kernels are selected once at startup.
+struct Kernels {
+    void (*yuv444_row)(const uint32_t*, uint8_t*, uint8_t*, uint8_t*, int, const YuvMatrix&);
+    void (*chroma420_row)(const uint32_t*, const uint32_t*, uint8_t*, uint8_t*, int, const YuvMatrix&);
+    void (*rgb_row)(const uint8_t*, const uint8_t*, const uint8_t*, uint32_t*, int, int, const YuvMatrix&);
+};
+
+Kernels scalar_kernels() {
+    return {rgb_to_yuv444_row_scalar, rgb_to_chroma420_row_scalar, yuv_to_rgb_row_scalar};
+}
+
+Kernels best_kernels() {
+#if defined(HAVE_X86_SIMD)
+    if (__builtin_cpu_supports("avx2"))
+        return {rgb_to_yuv444_row_avx2, rgb_to_chroma420_row_avx2, yuv_to_rgb_row_avx2};
+#endif
+    return scalar_kernels();
+}
+
+// 4. Multi-threaded frame conversion, one horizontal slice per thread
+// ------------------------------------------------------------------
+// 'rows' is counted in units of 'row_step' so 4:2:0 slices start on even rows.
+void parallel_rows(int rows, int threads, const std::function<void(int, int)>& body, int row_step = 1) {
+    int units = (rows + row_step - 1) / row_step;
+    threads = std::max(1, std::min(threads, units));
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        int begin = units * t / threads * row_step;
+        int end = std::min(rows, units * (t + 1) / threads * row_step);
+        if (t == threads - 1)
+            body(begin, end); // the calling thread takes the last slice
+        else
+            workers.emplace_back(body, begin, end);
+    }
+    for (auto& w : workers) w.join();
+}
+
+void rgb_to_yuv444(const uint32_t* px, int w, int h, YuvImage& out, const YuvMatrix& m,
+                   const Kernels& k, int threads) {
+    out.allocate(w, h, false);
+    parallel_rows(h, threads, [&](int begin, int end) {
+        for (int row = begin; row < end; ++row) {
+            size_t o = static_cast<size_t>(row) * w;
+            k.yuv444_row(px + o, &out.y[o], &out.u[o], &out.v[o], w, m);
+        }
+    });
+}
+
+void rgb_to_yuv420(const uint32_t* px, int w, int h, YuvImage& out, const YuvMatrix& m,
+                   const Kernels& k, int threads) {
+    out.allocate(w, h, true);
+    parallel_rows(h, threads, [&](int begin, int end) {
+        for (int row = begin; row < end; ++row) {
+            size_t o = static_cast<size_t>(row) * w;
+            k.yuv444_row(px + o, &out.y[o], nullptr, nullptr, w, m); // luma only
+            if (row % 2 == 0) {
+                const uint32_t* next = px + static_cast<size_t>(std::min(row + 1, h - 1)) * w;
+                size_t co = static_cast<size_t>(row / 2) * out.chroma_width;
+                k.chroma420_row(px + o, next, &out.u[co], &out.v[co], w, m);
+            }
+        }
+    }, 2);
+}
+
+// Luma only: the grayscale image an encoder or detector would see.
+void rgb_to_luma(const uint32_t* px, int w, int h, std::vector<uint8_t>& luma, const YuvMatrix& m,
+                 const Kernels& k, int threads) {
+    luma.assign(static_cast<size_t>(w) * h, 0);
+    parallel_rows(h, threads, [&](int begin, int end) {
+        for (int row = begin; row < end; ++row) {
+            size_t o = static_cast<size_t>(row) * w;
+            k.yuv444_row(px + o, &luma[o], nullptr, nullptr, w, m);
+        }
+    });
+}
+
+void yuv_to_rgb(const YuvImage& in, std::vector<uint32_t>& px, const YuvMatrix& m, const Kernels& k, int threads) {
+    px.assign(static_cast<size_t>(in.width) * in.height, 0);
+    int shift = in.chroma_width == in.width ? 0 : 1;
+    parallel_rows(in.height, threads, [&](int begin, int end) {
+        for (int row = begin; row < end; ++row) {
+            size_t o = static_cast<size_t>(row) * in.width;
+            size_t co = static_cast<size_t>(row >> shift) * in.chroma_width;
+            k.rgb_row(&in.y[o], &in.u[co], &in.v[co], &px[o], in.width, shift, m);
+        }
+    });
+}
+
+// 5. Float reference (the "per-pixel float code" being replaced)
+// --------------------------------------------------------------
+void rgb_to_yuv444_float(const uint32_t* px, int w, int h, YuvImage& out, const YuvMatrix& m) {
+    out.allocate(w, h, false);
+    const double kg = 1.0 - m.kr - m.kb;
+    for (size_t i = 0; i < static_cast<size_t>(w) * h; ++i) {
+        double b = px[i] & 0xFF, g = (px[i] >> 8) & 0xFF, r = (px[i] >> 16) & 0xFF;
+        double y = m.kr * r + kg * g + m.kb * b;
+        out.y[i] = static_cast<uint8_t>(std::lround(16 + y * 219.0 / 255.0));
+        out.u[i] = static_cast<uint8_t>(std::lround(128 + (b - y) / (2 * (1 - m.kb)) * 224.0 / 255.0));
+        out.v[i] = static_cast<uint8_t>(std::lround(128 + (r - y) / (2 * (1 - m.kr)) * 224.0 / 255.0));
+    }
+}
+
+int max_abs_diff(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    int d = 0;
+    for (size_t i = 0; i < a.size(); ++i) d = std::max(d, std::abs(a[i] - b[i]));
+    return d;
+}
+
+int max_channel_diff(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    int d = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+        for (int s = 0; s < 24; s += 8)
+            d = std::max(d, std::abs(static_cast<int>((a[i] >> s) & 0xFF) - static_cast<int>((b[i] >> s) & 0xFF)));
+    return d;
+}
+
+int main() {
+    const int w = 1920, h = 1080;
+    std::vector<uint32_t> frame(static_cast<size_t>(w) * h);
+    uint32_t x = 12345;
+    for (int row = 0; row < h; ++row)
+        for (int col = 0; col < w; ++col) {
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            // Smooth gradients plus a little noise, like natural video.
+            uint32_t r = (col * 255 / w + (x & 7)) & 0xFF, g = (row * 255 / h + ((x >> 3) & 7)) & 0xFF;
+            uint32_t b = ((col + row) * 255 / (w + h)) & 0xFF;
+            frame[static_cast<size_t>(row) * w + col] = 0xFF000000u | (r << 16) | (g << 8) | b;
+        }
+
+    const Kernels simd = best_kernels(), scalar = scalar_kernels();
+    const int threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << "[1] Single pixel 0xAABBCCDD (section 1's color)" << std::endl;
+    uint32_t color = 0xAABBCCDD;
+    for (const YuvMatrix* m : {&BT601, &BT709}) {
+        uint8_t y, u, v;
+        rgb_to_yuv444_row_scalar(&color, &y, &u, &v, 1, *m);
+        uint32_t back;
+        yuv_to_rgb_row_scalar(&y, &u, &v, &back, 1, 0, *m);
+        std::cout << "  " << m->name << ": Y=" << int(y) << " U=" << int(u) << " V=" << int(v)
+                  << " -> back to 0x" << std::hex << back << std::dec << std::endl;
+    }
+
+    std::cout << "[2] Accuracy on a 1080p frame" << std::endl;
+    for (const YuvMatrix* m : {&BT601, &BT709}) {
+        YuvImage fixed_simd, fixed_scalar, ref, yuv420_simd, yuv420_scalar;
+        rgb_to_yuv444(frame.data(), w, h, fixed_simd, *m, simd, threads);
+        rgb_to_yuv444(frame.data(), w, h, fixed_scalar, *m, scalar, 1);
+        rgb_to_yuv444_float(frame.data(), w, h, ref, *m);
+        rgb_to_yuv420(frame.data(), w, h, yuv420_simd, *m, simd, threads);
+        rgb_to_yuv420(frame.data(), w, h, yuv420_scalar, *m, scalar, 1);
+        bool identical = fixed_simd.y == fixed_scalar.y && fixed_simd.u == fixed_scalar.u &&
+                         fixed_simd.v == fixed_scalar.v && yuv420_simd.y == yuv420_scalar.y &&
+                         yuv420_simd.u == yuv420_scalar.u && yuv420_simd.v == yuv420_scalar.v;
+        std::vector<uint32_t> back_simd, back_scalar;
+        yuv_to_rgb(fixed_simd, back_simd, *m, simd, threads);
+        yuv_to_rgb(fixed_simd, back_scalar, *m, scalar, 1);
+        std::cout << "  " << m->name << ": SIMD == scalar fixed point: " << (identical && back_simd == back_scalar ? "yes" : "NO")
+                  << ", max |fixed - float| Y/U/V: " << max_abs_diff(fixed_simd.y, ref.y) << "/"
+                  << max_abs_diff(fixed_simd.u, ref.u) << "/" << max_abs_diff(fixed_simd.v, ref.v)
+                  << ", RGB round trip max error: " << max_channel_diff(frame, back_simd) << std::endl;
+    }
+
+    std::cout << "[3] Time per 1080p frame (" << threads << " threads for SIMD)" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    auto bench = [](const char* label, const std::function<void()>& fn) {
+        fn(); // warm up
+        auto t = std::chrono::steady_clock::now();
+        const int reps = 10;
+        for (int r = 0; r < reps; ++r) fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count() / reps;
+        std::cout << "  " << std::left << std::setw(30) << label << std::right << ms << " ms" << std::endl;
+    };
+    YuvImage out;
+    std::vector<uint8_t> luma;
+    std::vector<uint32_t> rgb;
+    bench("float reference, 4:4:4", [&] { rgb_to_yuv444_float(frame.data(), w, h, out, BT709); });
+    bench("scalar fixed point, 4:4:4", [&] { rgb_to_yuv444(frame.data(), w, h, out, BT709, scalar, 1); });
+    bench("SIMD, 4:4:4", [&] { rgb_to_yuv444(frame.data(), w, h, out, BT709, simd, threads); });
+    bench("SIMD, 4:2:0", [&] { rgb_to_yuv420(frame.data(), w, h, out, BT709, simd, threads); });
+    bench("SIMD, luma only", [&] { rgb_to_luma(frame.data(), w, h, luma, BT709, simd, threads); });
+    rgb_to_yuv420(frame.data(), w, h, out, BT709, simd, threads);
+    bench("SIMD, 4:2:0 -> RGB", [&] { yuv_to_rgb(out, rgb, BT709, simd, threads); });
+    return 0;
+}
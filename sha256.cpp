@@ -0,0 +1,506 @@
+/*
+ * sha256.cpp
+ * ----------
+ * SHA-256 for tamper evidence, with hardware and multi-buffer kernels.
+ *
+ * error_detection_demo() in crc-8.cpp shows what checksums are for: random
+ * corruption (a flipped bit, swapped bytes). Anyone who can change an
+ * artifact can also fix up its CRC-8 or its sum, because those are linear and
+ * tiny; a cryptographic hash cannot be matched by a modified input.
+ *
+ * 1. Scalar SHA-256 compression: 64 rounds per 64-byte block, the reference.
+ * 2. SHA-NI: sha256rnds2 runs two rounds per instruction and sha256msg1/2
+ *    expand the message schedule; the state lives in two registers as
+ *    ABEF/CDGH.
+ * 3. Multi-buffer AVX2: one message per 32-bit lane, eight messages per pass.
+ *    The rounds of a single message depend on each other, so one message
+ *    cannot use the width; eight independent ones can. Blocks are transposed
+ *    so register j holds word j of all eight blocks.
+ * 4. Dispatch: the single-buffer kernel (SHA-NI or scalar) is chosen once at
+ *    startup, as for the vector kernels in fast_hash.cpp; batches of small
+ *    objects use the 8-lane kernel only when there is no SHA-NI.
+ * 5. Streaming API: Sha256::update() in pieces, final() for the digest.
+ * 6. Demo: test vectors, cross-checks of all kernels, a CRC-8 forgery that
+ *    SHA-256 catches, and throughput.
+ */
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+using Digest = std::array<uint8_t, 32>;
+
+alignas(64) const uint32_t kRound[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t kInitialState[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+inline uint32_t load_be32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return __builtin_bswap32(v);
+}
+
+inline void store_be32(uint8_t* p, uint32_t v) {
+    v = __builtin_bswap32(v);
+    std::memcpy(p, &v, 4);
+}
+
+inline void store_be64(uint8_t* p, uint64_t v) {
+    v = __builtin_bswap64(v);
+    std::memcpy(p, &v, 8);
+}
+
+// Appends 0x80, zeros and the bit length to the last partial block 'tail'
+// (len % 64 bytes, copied into 'out'); returns the number of blocks, 1 or 2.
+size_t pad_tail(const uint8_t* tail, size_t tail_len, uint64_t total_len, uint8_t out[128]) {
+    size_t blocks = tail_len + 9 > 64 ? 2 : 1;
+    std::memset(out, 0, 128);
+    std::memcpy(out, tail, tail_len);
+    out[tail_len] = 0x80;
+    store_be64(out + blocks * 64 - 8, total_len * 8);
+    return blocks;
+}
+
+// 1. Scalar
+// ---------
+inline uint32_t rotr(uint32_t x, int r) { return (x >> r) | (x << (32 - r)); }
+
+void compress_scalar(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        uint32_t w[64];
+        for (int t = 0; t < 16; ++t) w[t] = load_be32(data + 4 * t);
+        for (int t = 16; t < 64; ++t) {
+            uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0; t < 64; ++t) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + kRound[t] + w[t];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+// 2. SHA-NI
+// ---------
+// Each group of 4 rounds: add the round constants to 4 schedule words, run
+// sha256rnds2 twice (rounds i, i+1 on the low half, then i+2, i+3), and
+// extend the schedule 4 words ahead. The schedule is a ring of 4 registers.
+__attribute__((target("sha,sse4.1")))
+void compress_shani(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    const __m128i kByteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);     // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);    // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);         // CDGH
+
+    for (; blocks > 0; --blocks, data += 64) {
+        __m128i abef = state0, cdgh = state1;
+        __m128i w[4];
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; ++i) {
+            if (i < 4) w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), kByteSwap);
+            __m128i msg = _mm_add_epi32(w[i % 4], _mm_load_si128(reinterpret_cast<const __m128i*>(kRound + 4 * i)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (i >= 3 && i < 15) {
+                __m128i& next = w[(i + 1) % 4];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(w[i % 4], w[(i + 3) % 4], 4));
+                next = _mm_sha256msg2_epu32(next, w[i % 4]);
+            }
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+            if (i >= 1 && i <= 12) w[(i + 3) % 4] = _mm_sha256msg1_epu32(w[(i + 3) % 4], w[i % 4]);
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);               // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);            // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);         // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);            // HGFE
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+// 3. Multi-buffer AVX2
+// --------------------
+// State of eight messages, word-major: lanes[w] holds word w of every message.
+struct State8 {
+    alignas(32) uint32_t lanes[8][8];
+};
+
+__attribute__((target("avx2"))) inline __m256i rotr8(__m256i x, int r) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, r), _mm256_slli_epi32(x, 32 - r));
+}
+
+// Loads 32 bytes from each of 8 blocks and transposes them: out[j] = word j
+// of every block, byte-swapped to big-endian.
+__attribute__((target("avx2")))
+inline void load_transposed(const uint8_t* const block[8], size_t offset, __m256i out[8]) {
+    const __m256i kByteSwap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                              12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i r[8], t[8], u[8];
+    for (int j = 0; j < 8; ++j) r[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block[j] + offset));
+    for (int j = 0; j < 8; j += 2) {
+        t[j] = _mm256_unpacklo_epi32(r[j], r[j + 1]);
+        t[j + 1] = _mm256_unpackhi_epi32(r[j], r[j + 1]);
+    }
+    for (int j = 0; j < 8; j += 4) {
+        u[j] = _mm256_unpacklo_epi64(t[j], t[j + 2]);
+        u[j + 1] = _mm256_unpackhi_epi64(t[j], t[j + 2]);
+        u[j + 2] = _mm256_unpacklo_epi64(t[j + 1], t[j + 3]);
+        u[j + 3] = _mm256_unpackhi_epi64(t[j + 1], t[j + 3]);
+    }
+    for (int j = 0; j < 4; ++j) {
+        out[j] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u[j], u[j + 4], 0x20), kByteSwap);
+        out[j + 4] = _mm256_shuffle_epi8(_mm256_permute2x128_si256(u[j], u[j + 4], 0x31), kByteSwap);
+    }
+}
+
+// One 64-byte block from each of the eight lanes.
+__attribute__((target("avx2")))
+void compress_avx2_x8(State8& st, const uint8_t* const block[8]) {
+    __m256i w[16];
+    load_transposed(block, 0, w);
+    load_transposed(block, 32, w + 8);
+    __m256i s[8];
+    for (int j = 0; j < 8; ++j) s[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(st.lanes[j]));
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+#pragma GCC unroll 64
+    for (int t = 0; t < 64; ++t) {
+        if (t >= 16) {
+            __m256i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr8(w15, 7), rotr8(w15, 18)), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr8(w2, 17), rotr8(w2, 19)), _mm256_srli_epi32(w2, 10));
+            w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+        }
+        __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotr8(e, 6), rotr8(e, 11)), rotr8(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1),
+                                      _mm256_add_epi32(_mm256_add_epi32(ch, w[t & 15]),
+                                                       _mm256_set1_epi32(static_cast<int>(kRound[t]))));
+        __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotr8(a, 2), rotr8(a, 13)), rotr8(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm256_add_epi32(t1, _mm256_add_epi32(sigma0, maj));
+    }
+    __m256i out[8] = {a, b, c, d, e, f, g, h};
+    for (int j = 0; j < 8; ++j)
+        _mm256_store_si256(reinterpret_cast<__m256i*>(st.lanes[j]), _mm256_add_epi32(s[j], out[j]));
+}
+
+// Hashes up to eight messages of any lengths in one pass of the 8-lane kernel.
+// A lane that runs out of blocks keeps hashing a dummy block; its digest was
+// taken when its last real block finished.
+void sha256_x8(const uint8_t* const msg[], const size_t len[], size_t count, Digest out[]) {
+    alignas(64) static const uint8_t kDummy[64] = {};
+    alignas(64) uint8_t tails[8][128];
+    size_t full[8], total[8], max_blocks = 0;
+    State8 st;
+    for (size_t j = 0; j < 8; ++j) {
+        for (int w = 0; w < 8; ++w) st.lanes[w][j] = kInitialState[w];
+        if (j >= count) { full[j] = total[j] = 0; continue; }
+        full[j] = len[j] / 64;
+        total[j] = full[j] + pad_tail(msg[j] + full[j] * 64, len[j] % 64, len[j], tails[j]);
+        max_blocks = std::max(max_blocks, total[j]);
+    }
+    for (size_t b = 0; b < max_blocks; ++b) {
+        const uint8_t* block[8];
+        for (size_t j = 0; j < 8; ++j)
+            block[j] = b < full[j] ? msg[j] + b * 64 : b < total[j] ? tails[j] + (b - full[j]) * 64 : kDummy;
+        compress_avx2_x8(st, block);
+        for (size_t j = 0; j < count; ++j)
+            if (total[j] == b + 1)
+                for (int w = 0; w < 8; ++w) store_be32(out[j].data() + 4 * w, st.lanes[w][j]);
+    }
+}
+
+// 4. Dispatch
+// -----------
+struct Sha256Kernel {
+    const char* name;
+    void (*compress)(uint32_t state[8], const uint8_t* data, size_t blocks);
+};
+
+const Sha256Kernel kScalarKernel{"scalar", compress_scalar};
+const Sha256Kernel kShaNiKernel{"sha-ni", compress_shani};
+
+const Sha256Kernel* select_sha256_kernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) return &kShaNiKernel;
+    return &kScalarKernel;
+}
+
+const Sha256Kernel* g_sha256 = select_sha256_kernel(); // the demo switches this to compare
+const bool g_have_avx2 = __builtin_cpu_supports("avx2");
+
+Digest sha256(const uint8_t* data, size_t len) {
+    uint32_t state[8];
+    std::memcpy(state, kInitialState, sizeof(state));
+    g_sha256->compress(state, data, len / 64);
+    uint8_t tail[128];
+    size_t blocks = pad_tail(data + len / 64 * 64, len % 64, len, tail);
+    g_sha256->compress(state, tail, blocks);
+    Digest d;
+    for (int w = 0; w < 8; ++w) store_be32(d.data() + 4 * w, state[w]);
+    return d;
+}
+
+Digest sha256(const std::vector<uint8_t>& data) { return sha256(data.data(), data.size()); }
+
+// Many small objects: with SHA-NI one message at a time is fastest; without
+// it, messages are sorted by length and hashed eight per pass, so lanes in a
+// pass need about the same number of blocks.
+std::vector<Digest> sha256_batch(const std::vector<std::vector<uint8_t>>& objects, bool allow_x8 = true) {
+    std::vector<Digest> out(objects.size());
+    if (g_sha256 == &kShaNiKernel || !g_have_avx2 || !allow_x8) {
+        for (size_t i = 0; i < objects.size(); ++i) out[i] = sha256(objects[i]);
+        return out;
+    }
+    std::vector<size_t> order(objects.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return objects[a].size() < objects[b].size(); });
+    for (size_t i = 0; i < order.size(); i += 8) {
+        size_t count = std::min<size_t>(8, order.size() - i);
+        const uint8_t* msg[8];
+        size_t len[8];
+        Digest d[8];
+        for (size_t j = 0; j < count; ++j) {
+            msg[j] = objects[order[i + j]].data();
+            len[j] = objects[order[i + j]].size();
+        }
+        sha256_x8(msg, len, count, d);
+        for (size_t j = 0; j < count; ++j) out[order[i + j]] = d[j];
+    }
+    return out;
+}
+
+// 5. Streaming
+// ------------
+class Sha256 {
+public:
+    Sha256() { reset(); }
+
+    void reset() {
+        std::memcpy(state_, kInitialState, sizeof(state_));
+        buffered_ = 0;
+        total_ = 0;
+    }
+
+    void update(const uint8_t* data, size_t len) {
+        total_ += len;
+        if (buffered_ > 0) {
+            size_t take = std::min(len, 64 - buffered_);
+            std::memcpy(buffer_ + buffered_, data, take);
+            buffered_ += take;
+            data += take;
+            len -= take;
+            if (buffered_ < 64) return;
+            g_sha256->compress(state_, buffer_, 1);
+            buffered_ = 0;
+        }
+        g_sha256->compress(state_, data, len / 64); // whole blocks straight from the input
+        std::memcpy(buffer_, data + len / 64 * 64, len % 64);
+        buffered_ = len % 64;
+    }
+
+    void update(const std::vector<uint8_t>& data) { update(data.data(), data.size()); }
+
+    Digest final() {
+        uint8_t tail[128];
+        g_sha256->compress(state_, tail, pad_tail(buffer_, buffered_, total_, tail));
+        Digest d;
+        for (int w = 0; w < 8; ++w) store_be32(d.data() + 4 * w, state_[w]);
+        reset();
+        return d;
+    }
+
+private:
+    uint32_t state_[8];
+    uint8_t buffer_[64];
+    size_t buffered_;
+    uint64_t total_;
+};
+
+// 6. Demo
+// -------
+std::string hex(const Digest& d) {
+    static const char* digits = "0123456789abcdef";
+    std::string s;
+    for (uint8_t b : d) {
+        s += digits[b >> 4];
+        s += digits[b & 15];
+    }
+    return s;
+}
+
+uint8_t crc8_checksum(const std::vector<uint8_t>& data) {
+    uint8_t crc = 0x00;
+    for (uint8_t byte : data) {
+        crc ^= byte;
+        for (int i = 0; i < 8; ++i) crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+uint64_t next_random(uint64_t& x) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    return x;
+}
+
+template <typename Callback>
+double time_ms(Callback cb) {
+    auto t = std::chrono::steady_clock::now();
+    cb();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+int main() {
+    const Sha256Kernel* best = g_sha256;
+    std::vector<const Sha256Kernel*> kernels{&kScalarKernel};
+    if (best == &kShaNiKernel) kernels.push_back(&kShaNiKernel);
+    std::cout << "Single-buffer kernel: " << best->name << ", 8-lane AVX2: " << (g_have_avx2 ? "yes" : "no")
+              << std::endl;
+
+    // [1] FIPS 180-2 test vectors.
+    struct Vector { std::string msg; size_t repeat; const char* digest; };
+    const Vector vectors[] = {
+        {"abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+        {"", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+        {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+         "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+        {"a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+    };
+    std::cout << "[1] Test vectors" << std::endl;
+    for (const Sha256Kernel* k : kernels) {
+        g_sha256 = k;
+        int ok = 0;
+        for (const Vector& v : vectors) {
+            std::string s;
+            for (size_t r = 0; r < v.repeat; ++r) s += v.msg;
+            ok += hex(sha256(reinterpret_cast<const uint8_t*>(s.data()), s.size())) == v.digest;
+        }
+        std::cout << "  " << std::left << std::setw(8) << k->name << std::right << ok << "/4 match" << std::endl;
+    }
+    g_sha256 = best;
+
+    // [2] Every kernel, the 8-lane batch and streaming agree on random messages.
+    {
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        std::vector<std::vector<uint8_t>> objects(3000);
+        for (size_t i = 0; i < objects.size(); ++i) {
+            objects[i].resize(i < 300 ? i : next_random(x) % 5000);
+            for (uint8_t& b : objects[i]) b = static_cast<uint8_t>(next_random(x));
+        }
+        g_sha256 = &kScalarKernel;
+        std::vector<Digest> reference = sha256_batch(objects, false);
+        g_sha256 = best;
+        size_t bad_best = 0, bad_x8 = 0, bad_stream = 0;
+        std::vector<Digest> one = sha256_batch(objects, false);
+        for (size_t i = 0; i < objects.size(); ++i) bad_best += one[i] != reference[i];
+        if (g_have_avx2) {
+            g_sha256 = &kScalarKernel; // forces the 8-lane path in sha256_batch
+            std::vector<Digest> x8 = sha256_batch(objects);
+            g_sha256 = best;
+            for (size_t i = 0; i < objects.size(); ++i) bad_x8 += x8[i] != reference[i];
+        }
+        Sha256 stream;
+        for (size_t i = 0; i < objects.size(); ++i) {
+            for (size_t pos = 0; pos < objects[i].size();) {
+                size_t piece = std::min<size_t>(next_random(x) % 200, objects[i].size() - pos);
+                stream.update(objects[i].data() + pos, piece);
+                pos += piece;
+            }
+            bad_stream += stream.final() != reference[i];
+        }
+        std::cout << "[2] " << objects.size() << " random messages (0..5000 bytes) against scalar: " << best->name
+                  << " " << bad_best << " mismatches, 8-lane " << bad_x8 << ", streaming " << bad_stream << std::endl;
+    }
+
+    // [3] Tamper evidence: change an artifact, then fix up its CRC-8 with one byte.
+    {
+        std::string text = "artifact v1.4.2: pay 100 to account 12345;";
+        std::vector<uint8_t> original(text.begin(), text.end());
+        original.push_back(0);
+        std::vector<uint8_t> forged = original;
+        forged[text.find("100")] = '9';                       // pay 900
+        std::memcpy(forged.data() + text.find("12345"), "66666", 5); // to another account
+        for (int pad = 0; pad < 256 && crc8_checksum(forged) != crc8_checksum(original); ++pad)
+            forged.back() = static_cast<uint8_t>(pad);
+        std::cout << "[3] Forged artifact \"" << std::string(forged.begin(), forged.end() - 1) << "\"" << std::endl;
+        std::cout << "  CRC-8:   original 0x" << std::hex << int(crc8_checksum(original)) << ", forged 0x"
+                  << int(crc8_checksum(forged)) << std::dec << " -> "
+                  << (crc8_checksum(original) == crc8_checksum(forged) ? "accepted" : "rejected") << std::endl;
+        std::cout << "  SHA-256: original " << hex(sha256(original)).substr(0, 16) << "..., forged "
+                  << hex(sha256(forged)).substr(0, 16) << "... -> "
+                  << (sha256(original) == sha256(forged) ? "accepted" : "rejected") << std::endl;
+    }
+
+    // [4] Throughput.
+    std::cout << std::fixed << std::setprecision(1);
+    std::vector<uint8_t> big(64 << 20);
+    uint64_t x = 0x2545F4914F6CDD1Dull;
+    for (uint8_t& b : big) b = static_cast<uint8_t>(next_random(x));
+    std::cout << "[4] One large message (64 MiB), MB/s:";
+    for (const Sha256Kernel* k : kernels) {
+        g_sha256 = k;
+        Digest d{};
+        double ms = time_ms([&] { d = sha256(big); });
+        std::cout << "  " << k->name << " " << big.size() / ms / 1e3;
+    }
+    g_sha256 = best;
+    std::cout << std::endl;
+
+    std::cout << "    Many small objects, MB/s (objects/s):" << std::endl;
+    for (size_t size : {64, 256, 1024, 4096}) {
+        std::vector<std::vector<uint8_t>> objects((32 << 20) / size);
+        for (auto& o : objects) o.assign(big.begin(), big.begin() + size);
+        std::cout << "  " << std::setw(5) << size << " bytes:";
+        auto run = [&](const char* label, const Sha256Kernel* k, bool x8) {
+            g_sha256 = k;
+            std::vector<Digest> d;
+            double ms = time_ms([&] { d = sha256_batch(objects, x8); });
+            std::cout << "  " << label << " " << std::setw(6) << objects.size() * size / ms / 1e3 << " ("
+                      << std::setprecision(2) << objects.size() / ms / 1e3 << "M)" << std::setprecision(1);
+        };
+        run("scalar", &kScalarKernel, false);
+        if (g_have_avx2) run("avx2 x8", &kScalarKernel, true);
+        if (best == &kShaNiKernel) run("sha-ni", &kShaNiKernel, false);
+        g_sha256 = best;
+        std::cout << std::endl;
+    }
+
+    /*
+     * SHA-NI is the fastest single-message path by far. The 8-lane AVX2
+     * kernel does the same scalar rounds in 8 lanes, so it is close to 8x
+     * the scalar throughput, which is what machines without SHA-NI get for
+     * batches of small objects. A tamper-evident store also needs the digest
+     * kept (or signed) where the attacker cannot rewrite it.
+     */
+    return 0;
+}
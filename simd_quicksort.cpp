@@ -0,0 +1,404 @@
+/*
+ * simd_quicksort.cpp
+ * ------------------
+ * From swapping two variables (swap_techniques.cpp) to a vectorized quicksort.
+ *
+ * Quicksort spends most of its time in partition: every element is compared
+ * with the pivot and swapped to the left or right side. A swap per element
+ * means a hard-to-predict branch per element (is x < pivot?).
+ *
+ * 1. Branchless swap: compare_exchange(a, b) puts min in a and max in b with
+ *    a masked XOR swap instead of "if (b < a) std::swap(a, b)". Sorting
+ *    networks are fixed sequences of compare_exchange; one sorts the leaves
+ *    (<= 16 keys).
+ * 2. Vectorized partition: load a vector of keys, compare all lanes with the
+ *    pivot at once, then write the "less" lanes to the left end and the rest to
+ *    the right end of the output:
+ *    - AVX-512: vpcompressd/q packs the selected lanes together; a masked
+ *      store writes exactly the right number of them.
+ *    - AVX2 has no compress, so a lookup table indexed by the comparison mask
+ *      gives a permutation that puts the "less" lanes first and the others
+ *      last. The permuted vector is stored at BOTH ends; each end keeps only
+ *      the lanes meant for it, the other lanes are overwritten later.
+ *    The partition works in place: the first and last vector are copied aside,
+ *    which opens a gap at each end. Reading the next vector from the side
+ *    with the smaller gap guarantees both gaps can take a full vector store.
+ * 3. The quicksort around it: median-of-16-samples pivot, recursion on the smaller side,
+ *    a depth limit that falls back to heapsort (as introsort does), and a
+ *    second "<= pivot" partition when nothing is smaller than the pivot, so
+ *    runs of equal keys finish in one pass.
+ * 4. Runtime dispatch between AVX-512, AVX2 and a branchless scalar
+ *    partition, for 32- and 64-bit signed keys, and a comparison with std::sort.
+ */
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+// 1. Branchless compare-exchange and a sorting network
+// ----------------------------------------------------
+// The XOR swap of swap_techniques.cpp, applied only when b < a: the mask is
+// all ones or all zeros, so there is no branch to mispredict. (Written with
+// std::min/std::max, GCC turns many of these into conditional jumps.)
+template <typename Key>
+inline void compare_exchange(Key& a, Key& b) {
+    Key mask = -static_cast<Key>(b < a);
+    Key diff = (a ^ b) & mask;
+    a ^= diff;
+    b ^= diff;
+}
+
+// Batcher's odd-even merge sort network for 16 inputs (63 comparators),
+// generated at compile time so the network can be fully unrolled.
+struct Network16 {
+    uint8_t pairs[64][2] = {};
+    int count = 0;
+    constexpr Network16() {
+        for (int p = 1; p < 16; p <<= 1)
+            for (int k = p; k >= 1; k >>= 1)
+                for (int j = k % p; j + k < 16; j += 2 * k)
+                    for (int i = 0; i < (k < 16 - j - k ? k : 16 - j - k); ++i)
+                        if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                            pairs[count][0] = static_cast<uint8_t>(i + j);
+                            pairs[count][1] = static_cast<uint8_t>(i + j + k);
+                            ++count;
+                        }
+    }
+};
+constexpr Network16 kNetwork16{};
+
+// With constant indices the 16 keys stay in registers and each comparator is
+// a min/max pair; with a runtime pair table they would go through memory.
+template <typename Key, size_t... C>
+inline void apply_network(Key* v, std::index_sequence<C...>) {
+    (compare_exchange(v[kNetwork16.pairs[C][0]], v[kNetwork16.pairs[C][1]]), ...);
+}
+
+// Sorts up to 16 keys: pad with the largest key, which sorts to the end.
+template <typename Key>
+void network_sort(Key* lo, Key* hi) {
+    Key v[16];
+    size_t n = static_cast<size_t>(hi - lo);
+    for (size_t i = 0; i < 16; ++i) v[i] = i < n ? lo[i] : std::numeric_limits<Key>::max();
+    apply_network(v, std::make_index_sequence<kNetwork16.count>{});
+    std::copy(v, v + n, lo);
+}
+
+// 2. Partition kernels
+// --------------------
+// All kernels reorder [lo, hi) so that keys "left of" the pivot come first and
+// return the boundary. Left means x < pivot, or x <= pivot when 'le' is set.
+template <typename Key>
+inline bool goes_left(Key x, Key pivot, bool le) { return le ? !(pivot < x) : x < pivot; }
+
+// Branchless Lomuto: always swap, advance the boundary only for left keys.
+template <typename Key>
+Key* partition_scalar(Key* lo, Key* hi, Key pivot, bool le) {
+    Key* w = lo;
+    for (Key* r = lo; r < hi; ++r) {
+        Key x = *r;
+        bool left = goes_left(x, pivot, le);
+        *r = *w;
+        *w = x;
+        w += left;
+    }
+    return w;
+}
+
+// Final step of the vector kernels: once the unread middle is copied to 'buf'
+// too, [l_write, r_write) is one free region and the buffered keys fill it.
+template <typename Key>
+Key* place_buffered(const Key* buf, size_t n, Key* l_write, Key* r_write, Key pivot, bool le) {
+    for (size_t i = 0; i < n; ++i) {
+        // Both slots are free, so write to both and keep one (no branch).
+        bool left = goes_left(buf[i], pivot, le);
+        *l_write = buf[i];
+        r_write[-1] = buf[i];
+        l_write += left;
+        r_write -= !left;
+    }
+    return l_write;
+}
+
+// AVX2 permutation tables: for every lane mask, the indices of the selected
+// lanes in order followed by the other lanes. 64-bit lanes are index pairs.
+struct PartitionLut {
+    alignas(32) int32_t perm32[256][8];
+    alignas(32) int32_t perm64[16][8];
+    PartitionLut() {
+        for (int m = 0; m < 256; ++m) {
+            int k = 0;
+            for (int i = 0; i < 8; ++i) if (m >> i & 1) perm32[m][k++] = i;
+            for (int i = 0; i < 8; ++i) if (!(m >> i & 1)) perm32[m][k++] = i;
+        }
+        for (int m = 0; m < 16; ++m) {
+            int k = 0;
+            for (int pass = 0; pass < 2; ++pass)
+                for (int i = 0; i < 4; ++i)
+                    if ((m >> i & 1) == (pass == 0)) {
+                        perm64[m][k++] = 2 * i;
+                        perm64[m][k++] = 2 * i + 1;
+                    }
+        }
+    }
+};
+static const PartitionLut kLut;
+
+// Requires hi - lo >= 2 vectors.
+template <typename Key>
+__attribute__((target("avx2,popcnt")))
+Key* partition_avx2(Key* lo, Key* hi, Key pivot, bool le) {
+    constexpr size_t V = 32 / sizeof(Key);
+    Key buf[3 * V];
+    std::memcpy(buf, lo, V * sizeof(Key));
+    std::memcpy(buf + V, hi - V, V * sizeof(Key));
+    Key *l_read = lo + V, *r_read = hi - V, *l_write = lo, *r_write = hi;
+    const __m256i p = sizeof(Key) == 4 ? _mm256_set1_epi32(static_cast<int32_t>(pivot))
+                                       : _mm256_set1_epi64x(static_cast<int64_t>(pivot));
+    const __m256i ones = _mm256_set1_epi32(-1);
+
+    while (static_cast<size_t>(r_read - l_read) >= V) {
+        __m256i v;
+        if (l_read - l_write <= r_write - r_read) {
+            v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(l_read));
+            l_read += V;
+        } else {
+            r_read -= V;
+            v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r_read));
+        }
+        unsigned mask;
+        __m256i perm;
+        if (sizeof(Key) == 4) {
+            __m256i left = le ? _mm256_xor_si256(_mm256_cmpgt_epi32(v, p), ones) : _mm256_cmpgt_epi32(p, v);
+            mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(left)));
+            perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(kLut.perm32[mask]));
+        } else {
+            __m256i left = le ? _mm256_xor_si256(_mm256_cmpgt_epi64(v, p), ones) : _mm256_cmpgt_epi64(p, v);
+            mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(left)));
+            perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(kLut.perm64[mask]));
+        }
+        size_t n_left = static_cast<size_t>(__builtin_popcount(mask));
+        __m256i s = _mm256_permutevar8x32_epi32(v, perm);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(l_write), s);     // first n_left lanes count
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(r_write - V), s); // last V - n_left lanes count
+        l_write += n_left;
+        r_write -= V - n_left;
+    }
+    size_t rest = static_cast<size_t>(r_read - l_read);
+    std::memcpy(buf + 2 * V, l_read, rest * sizeof(Key));
+    return place_buffered(buf, 2 * V + rest, l_write, r_write, pivot, le);
+}
+
+// Requires hi - lo >= 2 vectors.
+template <typename Key>
+__attribute__((target("avx512f,popcnt")))
+Key* partition_avx512(Key* lo, Key* hi, Key pivot, bool le) {
+    constexpr size_t V = 64 / sizeof(Key);
+    Key buf[3 * V];
+    std::memcpy(buf, lo, V * sizeof(Key));
+    std::memcpy(buf + V, hi - V, V * sizeof(Key));
+    Key *l_read = lo + V, *r_read = hi - V, *l_write = lo, *r_write = hi;
+    const __m512i p = sizeof(Key) == 4 ? _mm512_set1_epi32(static_cast<int32_t>(pivot))
+                                       : _mm512_set1_epi64(static_cast<int64_t>(pivot));
+
+    while (static_cast<size_t>(r_read - l_read) >= V) {
+        __m512i v;
+        if (l_read - l_write <= r_write - r_read) {
+            v = _mm512_loadu_si512(l_read);
+            l_read += V;
+        } else {
+            r_read -= V;
+            v = _mm512_loadu_si512(r_read);
+        }
+        if (sizeof(Key) == 4) {
+            __mmask16 m = le ? _mm512_cmple_epi32_mask(v, p) : _mm512_cmplt_epi32_mask(v, p);
+            unsigned n_left = static_cast<unsigned>(__builtin_popcount(m)), n_right = 16 - n_left;
+            _mm512_storeu_si512(l_write, _mm512_maskz_compress_epi32(m, v)); // left gap >= V
+            _mm512_mask_storeu_epi32(r_write - n_right, static_cast<__mmask16>((1u << n_right) - 1),
+                                     _mm512_maskz_compress_epi32(static_cast<__mmask16>(~m), v));
+            l_write += n_left;
+            r_write -= n_right;
+        } else {
+            __mmask8 m = le ? _mm512_cmple_epi64_mask(v, p) : _mm512_cmplt_epi64_mask(v, p);
+            unsigned n_left = static_cast<unsigned>(__builtin_popcount(m)), n_right = 8 - n_left;
+            _mm512_storeu_si512(l_write, _mm512_maskz_compress_epi64(m, v));
+            _mm512_mask_storeu_epi64(r_write - n_right, static_cast<__mmask8>((1u << n_right) - 1),
+                                     _mm512_maskz_compress_epi64(static_cast<__mmask8>(~m), v));
+            l_write += n_left;
+            r_write -= n_right;
+        }
+    }
+    size_t rest = static_cast<size_t>(r_read - l_read);
+    std::memcpy(buf + 2 * V, l_read, rest * sizeof(Key));
+    return place_buffered(buf, 2 * V + rest, l_write, r_write, pivot, le);
+}
+
+// 3. Quicksort
+// ------------
+template <typename Key>
+struct PartitionKernel {
+    Key* (*fn)(Key*, Key*, Key, bool);
+    size_t min_size; // the kernel needs at least this many keys
+    const char* name;
+};
+
+template <typename Key>
+inline Key median3(Key a, Key b, Key c) {
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+// Median of 16 samples (3 for short ranges), one at a pseudo-random position
+// in each sixteenth (third) of the range. Fixed positions -- median of 3,
+// ninther -- can be defeated by the order that the partition itself leaves
+// behind, e.g. on reversed input.
+template <typename Key>
+Key choose_pivot(const Key* lo, const Key* hi, uint64_t& rng) {
+    size_t n = static_cast<size_t>(hi - lo);
+    size_t count = n < 256 ? 3 : 16, stride = n / count;
+    Key sample[16];
+    for (size_t i = 0; i < count; ++i) {
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17; // xorshift64
+        sample[i] = lo[i * stride + rng % stride];
+    }
+    if (count == 3) return median3(sample[0], sample[1], sample[2]);
+    network_sort(sample, sample + 16);
+    return sample[8];
+}
+
+template <typename Key>
+void quicksort(Key* lo, Key* hi, int depth, const PartitionKernel<Key>& k, uint64_t& rng) {
+    while (hi - lo > 16) {
+        if (depth-- == 0) { // adversarial input: guarantee O(n log n)
+            std::make_heap(lo, hi);
+            std::sort_heap(lo, hi);
+            return;
+        }
+        size_t n = static_cast<size_t>(hi - lo);
+        auto part = n >= k.min_size ? k.fn : partition_scalar<Key>;
+        Key pivot = choose_pivot(lo, hi, rng);
+        Key* mid = part(lo, hi, pivot, false);
+        if (mid == lo) {
+            // Nothing below the pivot, so the pivot is the minimum: split off all
+            // keys equal to it (they are in their final place) and continue.
+            lo = part(lo, hi, pivot, true);
+            continue;
+        }
+        if (mid - lo < hi - mid) {
+            quicksort(lo, mid, depth, k, rng);
+            lo = mid;
+        } else {
+            quicksort(mid, hi, depth, k, rng);
+            hi = mid;
+        }
+    }
+    network_sort(lo, hi);
+}
+
+// 4. Dispatch
+// -----------
+template <typename Key>
+PartitionKernel<Key> kernel(const std::string& isa) {
+    if (isa == "avx512") return {partition_avx512<Key>, 2 * 64 / sizeof(Key), "AVX-512"};
+    if (isa == "avx2") return {partition_avx2<Key>, 2 * 32 / sizeof(Key), "AVX2"};
+    return {partition_scalar<Key>, 0, "scalar"};
+}
+
+template <typename Key>
+PartitionKernel<Key> best_kernel() {
+    if (__builtin_cpu_supports("avx512f")) return kernel<Key>("avx512");
+    if (__builtin_cpu_supports("avx2")) return kernel<Key>("avx2");
+    return kernel<Key>("scalar");
+}
+
+template <typename Key>
+void simd_sort(Key* data, size_t n, const PartitionKernel<Key>& k = best_kernel<Key>()) {
+    int depth = 2 * (64 - __builtin_clzll(n | 1));
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    quicksort(data, data + n, depth, k, rng);
+}
+
+// Benchmarks
+// ----------
+uint64_t next_random(uint64_t& x) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    return x;
+}
+
+template <typename Key>
+std::vector<Key> make_input(size_t n, const std::string& kind) {
+    std::vector<Key> v(n);
+    uint64_t x = 0x243F6A8885A308D3ull;
+    for (size_t i = 0; i < n; ++i) {
+        Key r = static_cast<Key>(next_random(x));
+        if (kind == "random") v[i] = r;
+        else if (kind == "few unique") v[i] = static_cast<Key>(r & 15);
+        else if (kind == "sorted") v[i] = static_cast<Key>(i);
+        else if (kind == "reversed") v[i] = static_cast<Key>(n - i);
+        else v[i] = 7; // all equal
+    }
+    return v;
+}
+
+template <typename Callback>
+double time_ms(Callback cb) {
+    auto t = std::chrono::steady_clock::now();
+    cb();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+template <typename Key>
+void bench(const char* type, size_t n) {
+    std::vector<std::string> isas = {"scalar"};
+    if (__builtin_cpu_supports("avx2")) isas.push_back("avx2");
+    if (__builtin_cpu_supports("avx512f")) isas.push_back("avx512");
+
+    std::cout << "[" << type << ", n = " << n << "]  time in ms, speedup vs std::sort" << std::endl;
+    for (const char* kind : {"random", "few unique", "sorted", "reversed", "all equal"}) {
+        std::vector<Key> input = make_input<Key>(n, kind), expected = input;
+        double t_std = time_ms([&] { std::sort(expected.begin(), expected.end()); });
+        std::cout << "  " << std::left << std::setw(11) << kind << std::right << " std::sort " << std::fixed
+                  << std::setprecision(1) << std::setw(7) << t_std;
+        for (const std::string& isa : isas) {
+            std::vector<Key> v = input;
+            PartitionKernel<Key> k = kernel<Key>(isa);
+            double t = time_ms([&] { simd_sort(v.data(), v.size(), k); });
+            std::cout << " | " << k.name << " " << std::setw(6) << t << " (" << std::setprecision(1)
+                      << t_std / t << "x)" << (v == expected ? "" : " WRONG");
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main() {
+    // The sorting network sorts every input of every size up to 16.
+    bool network_ok = true;
+    uint64_t x = 1;
+    for (int n = 0; n <= 16; ++n)
+        for (int rep = 0; rep < 1000; ++rep) {
+            int32_t v[16];
+            for (int i = 0; i < n; ++i) v[i] = static_cast<int32_t>(next_random(x) % 8) - 4;
+            network_sort(v, v + n);
+            network_ok &= std::is_sorted(v, v + n);
+        }
+    std::cout << "Sorting network: " << kNetwork16.count << " comparators, "
+              << (network_ok ? "sorts all tested inputs of size 0..16" : "FAILED") << std::endl << std::endl;
+
+    bench<int32_t>("int32", 10000000);
+    std::cout << std::endl;
+    bench<int64_t>("int64", 10000000);
+
+    /*
+     * The gain is largest on random keys, where std::sort mispredicts about
+     * every second comparison. On already sorted or reversed input its
+     * branches are perfectly predicted, and it can be as fast or faster.
+     */
+    return 0;
+}
@@ -0,0 +1,592 @@
+/*
+ * stream_checksum_filter.cpp
+ * --------------------------
+ * A pass-through filter for pipelines ("producer | filter - | consumer")
+ * that computes the CRC-32 of everything flowing through it and reports it
+ * at EOF, without the usual read()-then-write() double copy.
+ *
+ * A plain filter copies every byte twice: read() from the kernel into a user
+ * buffer, write() from that buffer back into the kernel. The checksum itself
+ * has to look at every byte once, so the best a filter can do is one pass
+ * over the data in user space and none for the forwarding:
+ *
+ * 1. CRC-32 (IEEE): the table version from delta_sync.cpp, plus a PCLMULQDQ
+ *    folding kernel (several GB/s), behind a streaming Crc32 context.
+ * 2. Output: the pipe the data is forwarded into. splice, tee and vmsplice
+ *    need a pipe on one side, so when stdout is a file or socket the filter
+ *    pushes into its own pipe and splices that out.
+ * 3. Forwarding modes, picked from what stdin is:
+ *    - pipe:    tee() duplicates the pipe's pages into the output pipe (no
+ *               copy, just page references), then read() consumes the same
+ *               bytes for the CRC. One copy instead of two.
+ *    - file:    mmap() the file for the CRC (no copy at all) and splice() it
+ *               from the page cache into the output.
+ *    - copy:    read()/write(), used for everything else (sockets, ttys).
+ *    - vmsplice (opt-in only): read() into page-aligned buffers, CRC, then
+ *               vmsplice() the buffers into the output pipe instead of
+ *               write(). Again one copy, but only safe when the consumer
+ *               read()s the pipe, which the filter cannot check. Needs stdout
+ *               to be a pipe itself; otherwise the copy mode is used.
+ * 4. Command line: "filter -" runs as a filter and prints the CRC-32 and
+ *    byte count to stderr at EOF.
+ * 5. Demo: every mode on a 256 MiB stream, checked against what the
+ *    consumer received, with the filter's CPU time per GiB.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+// 1. CRC-32 (IEEE, reflected polynomial 0xEDB88320)
+// -------------------------------------------------
+static uint32_t crc32_table[256];
+
+void init_crc32_table() {
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : c >> 1;
+        crc32_table[n] = c;
+    }
+}
+
+// Table kernel on the raw register (no pre/post inversion).
+uint32_t crc32_raw_table(uint32_t c, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) c = crc32_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c;
+}
+
+#if defined(HAVE_X86_SIMD)
+// Folding with carry-less multiplication (Intel, "Fast CRC Computation for
+// Generic Polynomials Using PCLMULQDQ"). Four 128-bit accumulators are each
+// multiplied by x^512 mod P and XORed with the next 64 bytes; at the end they
+// are folded into one, reduced to 64 and 32 bits, and a Barrett reduction
+// gives the remainder. The constants are the bit-reflected powers of x for
+// 0xEDB88320. Needs len >= 64 and a multiple of 16.
+__attribute__((target("pclmul,sse4.1"))) inline __m128i load128(const uint8_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+// x * k (both halves) + next: moves x forward by the distance k encodes.
+__attribute__((target("pclmul,sse4.1"))) inline __m128i fold128(__m128i x, __m128i k, __m128i next) {
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+uint32_t crc32_raw_pclmul(uint32_t c, const uint8_t* data, size_t len) {
+    const __m128i k1k2 = _mm_set_epi64x(0x1c6e41596, 0x154442bd4); // x^(512+32), x^(512-32)
+    const __m128i k3k4 = _mm_set_epi64x(0x0ccaa009e, 0x1751997d0); // x^(128+32), x^(128-32)
+    const __m128i k5 = _mm_set_epi64x(0, 0x163cd6124);             // x^64
+    const __m128i poly = _mm_set_epi64x(0x1f7011641, 0x1db710641); // mu, P
+    const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+    __m128i x0 = _mm_xor_si128(load128(data), _mm_cvtsi32_si128(static_cast<int>(c)));
+    __m128i x1 = load128(data + 16), x2 = load128(data + 32), x3 = load128(data + 48);
+    data += 64;
+    len -= 64;
+    for (; len >= 64; data += 64, len -= 64) {
+        x0 = fold128(x0, k1k2, load128(data));
+        x1 = fold128(x1, k1k2, load128(data + 16));
+        x2 = fold128(x2, k1k2, load128(data + 32));
+        x3 = fold128(x3, k1k2, load128(data + 48));
+    }
+    x0 = fold128(x0, k3k4, x1);
+    x0 = fold128(x0, k3k4, x2);
+    x0 = fold128(x0, k3k4, x3);
+    for (; len >= 16; data += 16, len -= 16) x0 = fold128(x0, k3k4, load128(data));
+
+    // 128 -> 64 bits.
+    x0 = _mm_xor_si128(_mm_clmulepi64_si128(x0, k3k4, 0x10), _mm_srli_si128(x0, 8));
+    // 64 -> 32 bits.
+    x0 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x0, mask32), k5, 0x00), _mm_srli_si128(x0, 4));
+    // Barrett reduction.
+    __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), poly, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), poly, 0x00);
+    return static_cast<uint32_t>(_mm_extract_epi32(_mm_xor_si128(x0, t), 1));
+}
+
+static const bool g_use_pclmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+
+// Streaming context: update() any number of times, value() at the end.
+class Crc32 {
+public:
+    void update(const uint8_t* data, size_t len) {
+#if defined(HAVE_X86_SIMD)
+        if (g_use_pclmul && len >= 64) {
+            size_t bulk = len & ~size_t(15);
+            reg_ = crc32_raw_pclmul(reg_, data, bulk);
+            data += bulk;
+            len -= bulk;
+        }
+#endif
+        reg_ = crc32_raw_table(reg_, data, len);
+    }
+
+    uint32_t value() const { return ~reg_; }
+
+private:
+    uint32_t reg_ = 0xFFFFFFFFu;
+};
+
+uint32_t crc32(const uint8_t* data, size_t len) {
+    Crc32 crc;
+    crc.update(data, len);
+    return crc.value();
+}
+
+// 2. Output side
+// --------------
+bool write_all(int fd, const uint8_t* p, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool is_fifo(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+// Where the modes put data: stdout itself when it is a pipe; otherwise a pipe
+// of our own whose contents flush() splices into stdout after every push.
+class PipeOut {
+public:
+    PipeOut(int out, size_t pipe_size) : out_(out) {
+        if (is_fifo(out)) {
+            fd_ = out;
+        } else if (pipe2(own_, O_CLOEXEC) == 0) {
+            fd_ = own_[1];
+        }
+        // A bigger pipe means fewer, larger transfers; the default is 64 KiB.
+        fcntl(fd_, F_SETPIPE_SZ, static_cast<int>(pipe_size));
+        int size = fcntl(fd_, F_GETPIPE_SZ);
+        capacity_ = size > 0 ? static_cast<size_t>(size) : 65536;
+    }
+
+    ~PipeOut() {
+        if (own_[0] >= 0) {
+            ::close(own_[0]);
+            ::close(own_[1]);
+        }
+    }
+
+    bool valid() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+    size_t capacity() const { return capacity_; }
+
+    // Moves 'len' bytes just pushed into fd() on to stdout (no-op when fd() is stdout).
+    bool flush(size_t len) {
+        if (own_[0] < 0) return true;
+        while (len > 0) {
+            ssize_t n = splice(own_[0], nullptr, out_, nullptr, len, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+private:
+    int out_;
+    int fd_ = -1;
+    int own_[2] = {-1, -1};
+    size_t capacity_ = 65536;
+};
+
+// 3. Forwarding modes
+// -------------------
+enum class Mode { kAuto, kCopy, kTee, kMmapSplice, kVmsplice };
+
+const char* mode_name(Mode m) {
+    switch (m) {
+    case Mode::kAuto: return "auto";
+    case Mode::kCopy: return "copy";
+    case Mode::kTee: return "tee";
+    case Mode::kMmapSplice: return "mmap+splice";
+    case Mode::kVmsplice: return "vmsplice";
+    }
+    return "?";
+}
+
+struct FilterResult {
+    bool ok = true;
+    Mode mode = Mode::kAuto;
+    uint64_t bytes = 0;
+    uint32_t crc = 0;
+};
+
+// read()/write(): two copies.
+bool forward_copy(int in, int out, Crc32& crc, uint64_t& bytes) {
+    std::vector<uint8_t> buf(1 << 18);
+    for (;;) {
+        ssize_t n = ::read(in, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) return true;
+        crc.update(buf.data(), static_cast<size_t>(n));
+        if (!write_all(out, buf.data(), static_cast<size_t>(n))) return false;
+        bytes += static_cast<uint64_t>(n);
+    }
+}
+
+// tee() leaves the data in 'in', so the following read() sees exactly the
+// bytes that were just forwarded.
+bool forward_tee(int in, PipeOut& out, Crc32& crc, uint64_t& bytes) {
+    std::vector<uint8_t> buf(out.capacity());
+    for (;;) {
+        ssize_t n = tee(in, out.fd(), out.capacity(), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) return true; // no data and no writers left
+        for (size_t left = static_cast<size_t>(n); left > 0;) {
+            ssize_t r = ::read(in, buf.data(), std::min(left, buf.size()));
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) return false;
+            crc.update(buf.data(), static_cast<size_t>(r));
+            left -= static_cast<size_t>(r);
+        }
+        if (!out.flush(static_cast<size_t>(n))) return false;
+        bytes += static_cast<uint64_t>(n);
+    }
+}
+
+// The CRC reads the page cache through the mapping and splice() forwards the
+// same pages, so user space copies nothing. A file that is rewritten while
+// it streams can differ between the two; pipes and sockets cannot.
+bool forward_mmap_splice(int in, PipeOut& out, Crc32& crc, uint64_t& bytes) {
+    struct stat st;
+    off_t start = lseek(in, 0, SEEK_CUR);
+    if (fstat(in, &st) != 0 || start < 0) return false;
+    size_t size = static_cast<size_t>(st.st_size);
+    const size_t kWindow = 64 << 20; // mapped at a time
+    for (loff_t off = start; static_cast<size_t>(off) < size;) {
+        size_t win = std::min(kWindow, size - static_cast<size_t>(off));
+        size_t page_off = static_cast<size_t>(off) & (static_cast<size_t>(sysconf(_SC_PAGESIZE)) - 1);
+        void* map = mmap(nullptr, win + page_off, PROT_READ, MAP_SHARED, in, off - static_cast<loff_t>(page_off));
+        if (map == MAP_FAILED) return false;
+        madvise(map, win + page_off, MADV_SEQUENTIAL);
+        const uint8_t* p = static_cast<const uint8_t*>(map) + page_off;
+        for (size_t done = 0; done < win;) {
+            size_t chunk = std::min(out.capacity(), win - done);
+            crc.update(p + done, chunk);
+            for (size_t left = chunk; left > 0;) {
+                ssize_t n = splice(in, &off, out.fd(), nullptr, left, SPLICE_F_MOVE | SPLICE_F_MORE);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    munmap(map, win + page_off);
+                    return false;
+                }
+                left -= static_cast<size_t>(n);
+            }
+            if (!out.flush(chunk)) {
+                munmap(map, win + page_off);
+                return false;
+            }
+            done += chunk;
+            bytes += chunk;
+        }
+        munmap(map, win + page_off);
+    }
+    // Whatever was appended after fstat() goes through the copy path.
+    return lseek(in, static_cast<off_t>(start + bytes), SEEK_SET) >= 0 && forward_copy(in, out.fd(), crc, bytes);
+}
+
+// vmsplice() puts references to our buffers into the pipe, so a buffer must
+// not be refilled while the pipe may still hold it. The pipe holds at most
+// capacity / page size buffers and each pushed page takes one, so once that
+// many pages have been pushed after a slot, the reader has taken the slot
+// out. The pushes are counted, and a slot that might still be in the pipe is
+// written with write() instead (which also moves the count on). The pipe is
+// kept small (see checksum_filter) so that the ring stays in cache.
+// This relies on the reader copying out of the pipe (read()); a reader that
+// splices the pages onward keeps them referenced and would see later data.
+// The filter cannot tell which kind of reader it has, so kAuto never picks
+// this mode; it must be requested explicitly.
+bool forward_vmsplice(int in, PipeOut& out, Crc32& crc, uint64_t& bytes) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t kSlot = 64 << 10;
+    const size_t pipe_pages = out.capacity() / page;
+    const size_t slots = pipe_pages * page / kSlot + 4; // slack for short reads
+    void* mem = mmap(nullptr, slots * kSlot, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return false;
+    uint8_t* ring = static_cast<uint8_t*>(mem);
+    std::vector<uint64_t> pushed_after(slots, 0); // page count when the slot was last pushed
+    uint64_t pages = pipe_pages;                  // pages pushed so far, offset so every slot starts free
+    bool ok = true;
+    for (size_t s = 0;; s = (s + 1) % slots) {
+        uint8_t* buf = ring + s * kSlot;
+        bool in_pipe = pages - pushed_after[s] < pipe_pages;
+        ssize_t n = ::read(in, buf, kSlot);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ok = n == 0;
+            break;
+        }
+        crc.update(buf, static_cast<size_t>(n));
+        if (in_pipe) {
+            // Only after many short reads. write() may fill the last page the
+            // pipe already has, so only whole pages are sure to be new ones.
+            ok = write_all(out.fd(), buf, static_cast<size_t>(n));
+            pages += static_cast<size_t>(n) / page;
+        } else {
+            struct iovec iov = {buf, static_cast<size_t>(n)};
+            while (iov.iov_len > 0) {
+                ssize_t m = vmsplice(out.fd(), &iov, 1, 0);
+                if (m < 0 && errno == EINTR) continue;
+                if (m <= 0) break;
+                iov.iov_base = static_cast<uint8_t*>(iov.iov_base) + m;
+                iov.iov_len -= static_cast<size_t>(m);
+            }
+            ok = iov.iov_len == 0;
+            pages += (static_cast<size_t>(n) + page - 1) / page;
+            pushed_after[s] = pages;
+        }
+        if (!ok || !out.flush(static_cast<size_t>(n))) {
+            ok = false;
+            break;
+        }
+        bytes += static_cast<uint64_t>(n);
+    }
+    munmap(mem, slots * kSlot);
+    return ok;
+}
+
+// Forwards everything from 'in' to 'out' unchanged and returns its CRC-32.
+// kAuto picks the cheapest mode that is safe for the kinds of descriptor
+// involved: tee for pipes, mmap+splice for files, copy otherwise.
+FilterResult checksum_filter(int in, int out, Mode mode = Mode::kAuto) {
+    struct stat in_st, out_st;
+    FilterResult r;
+    if (fstat(in, &in_st) != 0 || fstat(out, &out_st) != 0) {
+        r.ok = false;
+        return r;
+    }
+    // splice() to a tty, a character device or an O_APPEND file (">>") is not
+    // supported; those get copies.
+    bool spliceable = (S_ISFIFO(out_st.st_mode) || S_ISREG(out_st.st_mode) || S_ISSOCK(out_st.st_mode)) &&
+                      !(fcntl(out, F_GETFL) & O_APPEND);
+    if (mode == Mode::kAuto) {
+        mode = !spliceable                  ? Mode::kCopy
+             : S_ISFIFO(in_st.st_mode)      ? Mode::kTee
+             : S_ISREG(in_st.st_mode)       ? Mode::kMmapSplice
+                                            : Mode::kCopy;
+    }
+    // vmsplice()d pages must reach the consumer's read() directly: spliced on
+    // from our own pipe into a socket or file, they would still be referenced
+    // when the buffer is refilled.
+    if (mode == Mode::kVmsplice && !S_ISFIFO(out_st.st_mode)) mode = Mode::kCopy;
+    r.mode = mode;
+    Crc32 crc;
+    if (mode == Mode::kCopy) {
+        r.ok = forward_copy(in, out, crc, r.bytes);
+    } else {
+        PipeOut pipe_out(out, mode == Mode::kVmsplice ? 256 << 10 : 1 << 20);
+        r.ok = pipe_out.valid() && (mode == Mode::kTee           ? forward_tee(in, pipe_out, crc, r.bytes)
+                                    : mode == Mode::kMmapSplice ? forward_mmap_splice(in, pipe_out, crc, r.bytes)
+                                                                : forward_vmsplice(in, pipe_out, crc, r.bytes));
+    }
+    r.crc = crc.value();
+    return r;
+}
+
+// 4. Command line
+// ---------------
+int run_filter() {
+    FilterResult r = checksum_filter(STDIN_FILENO, STDOUT_FILENO);
+    std::fprintf(stderr, "crc32 %08x  %llu bytes  (%s)%s\n", r.crc, static_cast<unsigned long long>(r.bytes),
+                 mode_name(r.mode), r.ok ? "" : "  ERROR: stream incomplete");
+    return r.ok ? 0 : 1;
+}
+
+// 5. Demo
+// -------
+uint64_t next_random(uint64_t& x) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    return x;
+}
+
+template <typename Callback>
+pid_t spawn(Callback cb) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        cb();
+        _exit(0);
+    }
+    return pid;
+}
+
+struct Report {
+    uint32_t crc;
+    uint64_t bytes;
+    int ok;
+};
+
+const size_t kBlock = 1 << 20;
+const size_t kBlocks = 256; // 256 MiB per run
+
+enum class Input { kPipe, kFile, kSocket };
+
+// Runs producer -> filter -> consumer as three processes, the filter forced
+// into 'mode', and returns the filter's CPU time in ms (user + system). A
+// file input is read from 'path' instead of coming from a producer.
+double run_pipeline(Mode mode, Input input, const std::vector<uint8_t>& block, const char* path, Report& filter,
+                    Report& consumer) {
+    int data_in[2], data_out[2], rep_f[2], rep_c[2];
+    if (input == Input::kSocket) socketpair(AF_UNIX, SOCK_STREAM, 0, data_in);
+    else if (input == Input::kPipe) pipe(data_in);
+    pipe(data_out);
+    pipe(rep_f);
+    pipe(rep_c);
+    fcntl(data_out[0], F_SETPIPE_SZ, 1 << 20);
+
+    pid_t producer = -1;
+    int filter_in;
+    if (input == Input::kFile) {
+        filter_in = open(path, O_RDONLY);
+    } else {
+        producer = spawn([&] {
+            close(data_in[0]);
+            for (size_t b = 0; b < kBlocks; ++b) write_all(data_in[1], block.data(), block.size());
+        });
+        close(data_in[1]);
+        filter_in = data_in[0];
+    }
+    pid_t filt = spawn([&] {
+        close(data_out[0]);
+        FilterResult r = checksum_filter(filter_in, data_out[1], mode);
+        Report rep{r.crc, r.bytes, r.ok};
+        write_all(rep_f[1], reinterpret_cast<const uint8_t*>(&rep), sizeof(rep));
+    });
+    close(filter_in);
+    close(data_out[1]);
+    pid_t cons = spawn([&] {
+        std::vector<uint8_t> buf(1 << 18);
+        Crc32 crc;
+        Report rep{0, 0, 1};
+        ssize_t n;
+        while ((n = ::read(data_out[0], buf.data(), buf.size())) > 0) {
+            crc.update(buf.data(), static_cast<size_t>(n));
+            rep.bytes += static_cast<uint64_t>(n);
+        }
+        rep.crc = crc.value();
+        write_all(rep_c[1], reinterpret_cast<const uint8_t*>(&rep), sizeof(rep));
+    });
+    close(data_out[0]);
+
+    struct rusage ru;
+    int status;
+    wait4(filt, &status, 0, &ru);
+    if (producer > 0) waitpid(producer, &status, 0);
+    waitpid(cons, &status, 0);
+    read(rep_f[0], &filter, sizeof(filter));
+    read(rep_c[0], &consumer, sizeof(consumer));
+    for (int fd : {rep_f[0], rep_f[1], rep_c[0], rep_c[1]}) close(fd);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+int main(int argc, char** argv) {
+    init_crc32_table();
+    if (argc == 2 && std::string(argv[1]) == "-") return run_filter();
+    std::cout << "Usage as a filter: producer | " << argv[0] << " - | consumer  (CRC-32 on stderr at EOF)"
+              << std::endl << std::endl;
+
+    // [1] The CRC kernels: check value, then PCLMUL against the table on
+    // random lengths, offsets and update splits.
+    {
+        const char* check = "123456789";
+        std::cout << "[1] CRC-32(\"123456789\") = " << std::hex << crc32(reinterpret_cast<const uint8_t*>(check), 9)
+                  << std::dec << " (expected cbf43926)";
+#if defined(HAVE_X86_SIMD)
+        std::cout << ", PCLMUL " << (g_use_pclmul ? "in use" : "not available");
+#endif
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        std::vector<uint8_t> buf(8192 + 64);
+        for (uint8_t& b : buf) b = static_cast<uint8_t>(next_random(x));
+        size_t errors = 0;
+        for (int round = 0; round < 5000; ++round) {
+            size_t off = next_random(x) % 64, len = next_random(x) % 8192, split = len ? next_random(x) % len : 0;
+            const uint8_t* p = buf.data() + off;
+            Crc32 crc;
+            crc.update(p, split);
+            crc.update(p + split, len - split);
+            errors += crc.value() != ~crc32_raw_table(0xFFFFFFFFu, p, len);
+        }
+        std::cout << std::endl << "    5000 random cases against the table: " << errors << " errors" << std::endl;
+    }
+
+    // [2] The pipeline with each mode.
+    std::vector<uint8_t> block(kBlock);
+    uint64_t x = 0x2545F4914F6CDD1Dull;
+    for (uint8_t& b : block) b = static_cast<uint8_t>(next_random(x));
+    Crc32 expected_crc;
+    for (size_t b = 0; b < kBlocks; ++b) expected_crc.update(block.data(), block.size());
+    const uint32_t expected = expected_crc.value();
+    const char* path = "/tmp/stream_checksum_filter.dat";
+    {
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        for (size_t b = 0; b < kBlocks; ++b) write_all(fd, block.data(), block.size());
+        close(fd);
+    }
+
+    std::cout << "[2] producer -> filter -> consumer, " << kBlocks << " MiB, expected CRC " << std::hex << expected
+              << std::dec << std::endl;
+    std::cout << "  " << std::left << std::setw(13) << "mode" << std::setw(22) << "input" << std::right << std::setw(10)
+              << "filter CRC" << std::setw(13) << "consumer CRC" << std::setw(15) << "CPU ms / GiB" << std::endl;
+    struct Case {
+        Mode mode;
+        Input input;
+        const char* name;
+    };
+    const Case cases[] = {{Mode::kCopy, Input::kPipe, "pipe"},
+                          {Mode::kTee, Input::kPipe, "pipe"},
+                          {Mode::kCopy, Input::kFile, "file (page cache)"},
+                          {Mode::kMmapSplice, Input::kFile, "file (page cache)"},
+                          {Mode::kCopy, Input::kSocket, "unix socket"},
+                          {Mode::kVmsplice, Input::kSocket, "unix socket"}};
+    for (const Case& c : cases) {
+        Report f{}, r{};
+        double cpu = run_pipeline(c.mode, c.input, block, path, f, r);
+        bool good = f.ok && f.crc == expected && r.crc == expected && r.bytes == kBlocks * kBlock;
+        std::cout << "  " << std::left << std::setw(13) << mode_name(c.mode) << std::setw(22) << c.name << std::right
+                  << std::hex << std::setw(10) << f.crc << std::setw(13) << r.crc << std::dec << std::fixed
+                  << std::setprecision(1) << std::setw(15) << cpu * 1024.0 / kBlocks << (good ? "" : "  MISMATCH")
+                  << std::endl;
+    }
+    unlink(path);
+
+    /*
+     * The CPU column is the filter process alone (user + system time), which
+     * is what it adds to the pipeline. copy pays for two memcpy's per byte
+     * in the kernel plus the CRC. tee and vmsplice pay for one copy and the
+     * CRC; mmap+splice pays only for the CRC and for touching the mapping,
+     * since the page cache pages go into the pipe by reference. With the
+     * PCLMUL kernel the CRC runs at several GB/s, so what remains is mostly
+     * the single copy and the system calls, which get fewer as the pipe
+     * buffers grow (F_SETPIPE_SZ to 1 MiB above).
+     */
+    return 0;
+}
@@ -0,0 +1,418 @@
+/*
+ * stream_compaction.cpp
+ * ---------------------
+ * Filtering an array by a bit predicate without a branch per element.
+ *
+ * bitwise_and.cpp tests one value at a time: "if (player_state & STATE_ALIVE)"
+ * in section 7, "(num & 1) ? odd : even" in section 8. Run over a large
+ * array, "if (pred(x)) out[n++] = x;" costs a mispredicted branch for
+ * roughly every other element once the outcome is not predictable (around
+ * 50% selectivity), which is much more than the test itself.
+ *
+ * 1. Predicates: all bits of a mask set to a given pattern (flags, even/odd),
+ *    any bit of a mask set, and a closed range [lo, hi]. The range test is a
+ *    single unsigned compare: x - lo <= hi - lo.
+ * 2. Scalar kernels: the branchy loop, and the branchless one that always
+ *    stores and advances the output by 0 or 1.
+ * 3. AVX2: the predicate on 8 elements gives an 8-bit mask; a 256-entry
+ *    table maps that mask to a permutation that moves the survivors to the
+ *    front of the vector, which is stored whole and the output advanced by
+ *    popcount(mask).
+ * 4. AVX-512: 16 elements per step, and the compress instruction does the
+ *    table's job in hardware.
+ * 5. Each kernel produces either the surviving values or their indices
+ *    (the index list is what a later stage uses to gather other columns).
+ *    Dispatch picks the widest tier once, as in fast_hash.cpp.
+ *
+ * Every vector kernel stores a whole vector at the current output position.
+ * Since the output never gets ahead of the input, those stores stay inside
+ * an output array as long as the input, so no padding is needed.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+// 1. Predicates
+// -------------
+struct Predicate {
+    enum Kind { kMaskEquals, kMaskAny, kRange } kind;
+    uint32_t a, b; // kMaskEquals: mask, pattern; kMaskAny: mask, unused; kRange: lo, hi
+
+    static Predicate mask_equals(uint32_t mask, uint32_t pattern) { return {kMaskEquals, mask, pattern & mask}; }
+    static Predicate mask_any(uint32_t mask) { return {kMaskAny, mask, 0}; }
+    // b holds the span hi - lo; lo > hi selects nothing (it would wrap around).
+    static Predicate range(uint32_t lo, uint32_t hi) { return lo <= hi ? Predicate{kRange, lo, hi - lo} : none(); }
+    static Predicate none() { return mask_any(0); }
+    static Predicate even() { return mask_equals(1, 0); }
+    static Predicate odd() { return mask_equals(1, 1); }
+
+    bool operator()(uint32_t x) const {
+        switch (kind) {
+        case kMaskEquals: return (x & a) == b;
+        case kMaskAny: return (x & a) != 0;
+        case kRange: return x - a <= b;
+        }
+        return false;
+    }
+};
+
+// The kernels are templates on the predicate kind, so the inner loops do not
+// switch per element; the public functions switch once per call.
+template <Predicate::Kind K>
+inline bool test(uint32_t x, uint32_t a, uint32_t b) {
+    if (K == Predicate::kMaskEquals) return (x & a) == b;
+    if (K == Predicate::kMaskAny) return (x & a) != 0;
+    return x - a <= b;
+}
+
+// 2. Scalar kernels
+// -----------------
+// Reference: one branch per element.
+size_t compact_branchy(const uint32_t* in, size_t n, Predicate p, uint32_t* out) {
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (p(in[i])) out[k++] = in[i];
+    return k;
+}
+
+size_t indices_branchy(const uint32_t* in, size_t n, Predicate p, uint32_t* out) {
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (p(in[i])) out[k++] = static_cast<uint32_t>(i);
+    return k;
+}
+
+// Always store, advance by 0 or 1: the only dependency is k -> k.
+template <Predicate::Kind K>
+size_t compact_branchless(const uint32_t* in, size_t n, uint32_t a, uint32_t b, uint32_t* out) {
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t x = in[i];
+        out[k] = x;
+        k += test<K>(x, a, b);
+    }
+    return k;
+}
+
+template <Predicate::Kind K>
+size_t indices_branchless(const uint32_t* in, size_t n, uint32_t a, uint32_t b, uint32_t* out) {
+    size_t k = 0;
+    for (size_t i = 0; i < n; ++i) {
+        out[k] = static_cast<uint32_t>(i);
+        k += test<K>(in[i], a, b);
+    }
+    return k;
+}
+
+// 3. AVX2: shuffle table
+// ----------------------
+// Entry m lists the lanes whose bit is set in m, in order, then fills the rest
+// with 0 (those lanes are overwritten by the next store or left past the end).
+struct CompressTable {
+    alignas(32) uint32_t lanes[256][8];
+    CompressTable() {
+        for (int m = 0; m < 256; ++m) {
+            int k = 0;
+            for (int lane = 0; lane < 8; ++lane)
+                if (m & (1 << lane)) lanes[m][k++] = lane;
+            while (k < 8) lanes[m][k++] = 0;
+        }
+    }
+};
+
+static const CompressTable kCompress;
+
+#if defined(HAVE_X86_SIMD)
+template <Predicate::Kind K>
+__attribute__((target("avx2"))) inline __m256i test_avx2(__m256i x, __m256i a, __m256i b) {
+    if (K == Predicate::kMaskEquals) return _mm256_cmpeq_epi32(_mm256_and_si256(x, a), b);
+    if (K == Predicate::kMaskAny)
+        return _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_and_si256(x, a), _mm256_setzero_si256()),
+                                _mm256_set1_epi32(-1));
+    // Unsigned x - lo <= span: min(d, span) == d.
+    __m256i d = _mm256_sub_epi32(x, a);
+    return _mm256_cmpeq_epi32(_mm256_min_epu32(d, b), d);
+}
+
+template <Predicate::Kind K>
+__attribute__((target("avx2,popcnt")))
+size_t compact_avx2(const uint32_t* in, size_t n, uint32_t a, uint32_t b, uint32_t* out) {
+    const __m256i va = _mm256_set1_epi32(static_cast<int>(a)), vb = _mm256_set1_epi32(static_cast<int>(b));
+    size_t k = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        unsigned m = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(test_avx2<K>(x, va, vb))));
+        __m256i perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(kCompress.lanes[m]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), _mm256_permutevar8x32_epi32(x, perm));
+        k += __builtin_popcount(m);
+    }
+    return k + compact_branchless<K>(in + i, n - i, a, b, out + k);
+}
+
+template <Predicate::Kind K>
+__attribute__((target("avx2,popcnt")))
+size_t indices_avx2(const uint32_t* in, size_t n, uint32_t a, uint32_t b, uint32_t* out) {
+    const __m256i va = _mm256_set1_epi32(static_cast<int>(a)), vb = _mm256_set1_epi32(static_cast<int>(b));
+    const __m256i step = _mm256_set1_epi32(8);
+    __m256i idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    size_t k = 0, i = 0;
+    for (; i + 8 <= n; i += 8, idx = _mm256_add_epi32(idx, step)) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        unsigned m = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(test_avx2<K>(x, va, vb))));
+        __m256i perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(kCompress.lanes[m]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), _mm256_permutevar8x32_epi32(idx, perm));
+        k += __builtin_popcount(m);
+    }
+    size_t tail = indices_branchless<K>(in + i, n - i, a, b, out + k);
+    for (size_t j = 0; j < tail; ++j) out[k + j] += static_cast<uint32_t>(i);
+    return k + tail;
+}
+
+// 4. AVX-512: compress
+// --------------------
+// vpcompressd straight to memory is slow on some cores (it is microcoded on
+// Zen 4), so the survivors are compressed in a register and stored whole.
+template <Predicate::Kind K>
+__attribute__((target("avx512f"))) inline __mmask16 test_avx512(__m512i x, __m512i a, __m512i b) {
+    if (K == Predicate::kMaskEquals) return _mm512_cmpeq_epi32_mask(_mm512_and_si512(x, a), b);
+    if (K == Predicate::kMaskAny) return _mm512_test_epi32_mask(x, a);
+    return _mm512_cmple_epu32_mask(_mm512_sub_epi32(x, a), b);
+}
+
+template <Predicate::Kind K>
+__attribute__((target("avx512f,popcnt")))
+size_t compact_avx512(const uint32_t* in, size_t n, uint32_t a, uint32_t b, uint32_t* out) {
+    const __m512i va = _mm512_set1_epi32(static_cast<int>(a)), vb = _mm512_set1_epi32(static_cast<int>(b));
+    size_t k = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512(in + i);
+        __mmask16 m = test_avx512<K>(x, va, vb);
+        _mm512_storeu_si512(out + k, _mm512_maskz_compress_epi32(m, x));
+        k += __builtin_popcount(m);
+    }
+    // The tail with a masked load; the store writes only the survivors.
+    __mmask16 live = static_cast<__mmask16>((1u << (n - i)) - 1);
+    __m512i x = _mm512_maskz_loadu_epi32(live, in + i);
+    __mmask16 m = test_avx512<K>(x, va, vb) & live;
+    _mm512_mask_compressstoreu_epi32(out + k, m, x);
+    return k + __builtin_popcount(m);
+}
+
+template <Predicate::Kind K>
+__attribute__((target("avx512f,popcnt")))
+size_t indices_avx512(const uint32_t* in, size_t n, uint32_t a, uint32_t b, uint32_t* out) {
+    const __m512i va = _mm512_set1_epi32(static_cast<int>(a)), vb = _mm512_set1_epi32(static_cast<int>(b));
+    const __m512i step = _mm512_set1_epi32(16);
+    __m512i idx = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    size_t k = 0, i = 0;
+    for (; i + 16 <= n; i += 16, idx = _mm512_add_epi32(idx, step)) {
+        __mmask16 m = test_avx512<K>(_mm512_loadu_si512(in + i), va, vb);
+        _mm512_storeu_si512(out + k, _mm512_maskz_compress_epi32(m, idx));
+        k += __builtin_popcount(m);
+    }
+    __mmask16 live = static_cast<__mmask16>((1u << (n - i)) - 1);
+    __mmask16 m = test_avx512<K>(_mm512_maskz_loadu_epi32(live, in + i), va, vb) & live;
+    _mm512_mask_compressstoreu_epi32(out + k, m, idx);
+    return k + __builtin_popcount(m);
+}
+#endif
+
+// 5. Tiers and dispatch
+// ---------------------
+using CompactFn = size_t (*)(const uint32_t*, size_t, uint32_t, uint32_t, uint32_t*);
+
+// One entry per predicate kind, in Predicate::Kind order.
+struct CompactKernels {
+    const char* name;
+    CompactFn values[3];
+    CompactFn indices[3];
+};
+
+#define COMPACT_KERNELS(name, values, indices)                                                          \
+    CompactKernels {                                                                                    \
+        name, {values<Predicate::kMaskEquals>, values<Predicate::kMaskAny>, values<Predicate::kRange>}, \
+        {indices<Predicate::kMaskEquals>, indices<Predicate::kMaskAny>, indices<Predicate::kRange>}     \
+    }
+
+const CompactKernels kBranchless = COMPACT_KERNELS("branchless", compact_branchless, indices_branchless);
+#if defined(HAVE_X86_SIMD)
+const CompactKernels kAvx2 = COMPACT_KERNELS("avx2", compact_avx2, indices_avx2);
+const CompactKernels kAvx512 = COMPACT_KERNELS("avx512", compact_avx512, indices_avx512);
+#endif
+
+const CompactKernels* select_compact() {
+#if defined(HAVE_X86_SIMD)
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt")) return &kAvx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) return &kAvx2;
+#endif
+    return &kBranchless;
+}
+
+static const CompactKernels* const g_compact = select_compact();
+
+// Copies the elements of in[0, n) that satisfy p to out, in order, and
+// returns how many there were. out must have room for n elements.
+size_t compact(const uint32_t* in, size_t n, Predicate p, uint32_t* out) {
+    return g_compact->values[p.kind](in, n, p.a, p.b, out);
+}
+
+// Same, but writes the positions of the survivors instead of their values.
+size_t select_indices(const uint32_t* in, size_t n, Predicate p, uint32_t* out) {
+    return g_compact->indices[p.kind](in, n, p.a, p.b, out);
+}
+
+std::vector<uint32_t> compact(const std::vector<uint32_t>& in, Predicate p) {
+    std::vector<uint32_t> out(in.size());
+    out.resize(compact(in.data(), in.size(), p, out.data()));
+    return out;
+}
+
+// 6. Demo
+// -------
+uint64_t next_random(uint64_t& x) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    return x;
+}
+
+template <typename Callback>
+double time_ms(Callback cb) {
+    auto t = std::chrono::steady_clock::now();
+    cb();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+// The reference kernels wrapped to the tier signature, so the demo can treat
+// every tier the same way.
+size_t compact_branchy_fn(const uint32_t* in, size_t n, uint32_t a, uint32_t b, uint32_t* out) {
+    return compact_branchy(in, n, Predicate{Predicate::kRange, a, b}, out);
+}
+
+size_t indices_branchy_fn(const uint32_t* in, size_t n, uint32_t a, uint32_t b, uint32_t* out) {
+    return indices_branchy(in, n, Predicate{Predicate::kRange, a, b}, out);
+}
+
+int main() {
+    std::vector<const CompactKernels*> tiers{&kBranchless};
+#if defined(HAVE_X86_SIMD)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) tiers.push_back(&kAvx2);
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt")) tiers.push_back(&kAvx512);
+#endif
+    std::cout << "Dispatch uses: " << g_compact->name << std::endl;
+
+    // [1] bitwise_and.cpp's tests, applied to whole arrays.
+    {
+        const uint32_t ALIVE = 0x01, VISIBLE = 0x02, INVINCIBLE = 0x04;
+        std::vector<uint32_t> states{ALIVE | VISIBLE, 0, ALIVE, VISIBLE | INVINCIBLE, ALIVE | VISIBLE | INVINCIBLE,
+                                     VISIBLE, ALIVE | VISIBLE, INVINCIBLE, ALIVE | INVINCIBLE, ALIVE | VISIBLE};
+        std::vector<uint32_t> idx(states.size());
+        size_t k = select_indices(states.data(), states.size(), Predicate::mask_equals(ALIVE | VISIBLE, ALIVE | VISIBLE),
+                                  idx.data());
+        std::cout << "[1] Objects alive and visible:";
+        for (size_t j = 0; j < k; ++j) std::cout << " #" << idx[j];
+        k = select_indices(states.data(), states.size(), Predicate::mask_equals(ALIVE | INVINCIBLE, ALIVE), idx.data());
+        std::cout << std::endl << "    Alive, not invincible:";
+        for (size_t j = 0; j < k; ++j) std::cout << " #" << idx[j];
+        std::vector<uint32_t> nums{42, 7, 64, 13, 100, 0, 99, 8, 3, 21, 56, 77, 18, 5, 64, 1, 2, 31};
+        std::cout << std::endl << "    Odd:";
+        for (uint32_t v : compact(nums, Predicate::odd())) std::cout << " " << v;
+        std::cout << std::endl << "    In [10, 64]:";
+        for (uint32_t v : compact(nums, Predicate::range(10, 64))) std::cout << " " << v;
+        std::cout << std::endl;
+    }
+
+    // [2] The branchy kernels and every tier against a plain scalar
+    // reference that does not go through Predicate: random lengths, all
+    // predicate kinds, selectivity from none to all.
+    {
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        std::vector<uint32_t> in(2048), want(2048), got(2048);
+        size_t errors = 0, cases = 0;
+        for (int round = 0; round < 20000; ++round) {
+            size_t n = next_random(x) % (round < 4000 ? 40 : 2048);
+            for (uint32_t& v : in) v = static_cast<uint32_t>(next_random(x));
+            uint32_t r0 = static_cast<uint32_t>(next_random(x)), r1 = static_cast<uint32_t>(next_random(x));
+            uint32_t lo = round % 4 == 2 ? std::min(r0, r1) : std::max(r0, r1); // round % 4 == 3: lo > hi, empty
+            uint32_t hi = round % 4 == 2 ? std::max(r0, r1) : std::min(r0, r1);
+            Predicate p = round % 4 == 0 ? Predicate::mask_equals(r0 & 0x0F, r1)
+                        : round % 4 == 1 ? Predicate::mask_any(r0 & r1 & 0x111)
+                                         : Predicate::range(lo, hi);
+            auto keep = [&](uint32_t v) {
+                return round % 4 == 0 ? (v & r0 & 0x0F) == (r1 & r0 & 0x0F)
+                     : round % 4 == 1 ? (v & r0 & r1 & 0x111) != 0
+                                      : lo <= v && v <= hi;
+            };
+            for (int which = 0; which < 2; ++which) {
+                size_t kw = 0;
+                for (size_t i = 0; i < n; ++i)
+                    if (keep(in[i])) want[kw++] = which ? static_cast<uint32_t>(i) : in[i];
+                std::fill(got.begin(), got.end(), 0xDEADBEEF);
+                size_t kb = which ? indices_branchy(in.data(), n, p, got.data())
+                                  : compact_branchy(in.data(), n, p, got.data());
+                errors += kb != kw || !std::equal(want.begin(), want.begin() + kw, got.begin());
+                ++cases;
+                for (const CompactKernels* t : tiers) {
+                    std::fill(got.begin(), got.end(), 0xDEADBEEF);
+                    size_t kg = (which ? t->indices : t->values)[p.kind](in.data(), n, p.a, p.b, got.data());
+                    errors += kg != kw || !std::equal(want.begin(), want.begin() + kw, got.begin()) ||
+                              std::any_of(got.begin() + n, got.end(), [](uint32_t v) { return v != 0xDEADBEEF; });
+                    ++cases;
+                }
+            }
+        }
+        std::cout << "[2] " << cases << " cases against a scalar reference: " << errors << " errors" << std::endl;
+    }
+
+    // [3] Throughput against selectivity: range predicates on uniform random
+    // values, 256K elements (1 MiB in, stays in L2), million elements/ms.
+    std::vector<uint32_t> data(256 * 1024), out(data.size());
+    uint64_t x = 0x2545F4914F6CDD1Dull;
+    for (uint32_t& v : data) v = static_cast<uint32_t>(next_random(x));
+    const int reps = 200;
+    std::vector<std::pair<std::string, CompactFn>> kernels{{"branchy", compact_branchy_fn},
+                                                           {"branchy idx", indices_branchy_fn}};
+    for (const CompactKernels* t : tiers) {
+        kernels.push_back({t->name, t->values[Predicate::kRange]});
+        kernels.push_back({std::string(t->name) + " idx", t->indices[Predicate::kRange]});
+    }
+    const double selectivity[] = {0.01, 0.1, 0.5, 0.9, 0.99};
+    std::cout << "[3] Compaction throughput, elements per ns (" << data.size() << " elements)" << std::endl;
+    std::cout << "  " << std::left << std::setw(14) << "kernel" << std::right;
+    for (double s : selectivity) std::cout << std::setw(7) << int(s * 100) << "%";
+    std::cout << std::endl << std::fixed << std::setprecision(2);
+    for (const auto& [label, fn] : kernels) {
+        std::cout << "  " << std::left << std::setw(14) << label << std::right;
+        uint64_t sink = 0;
+        for (double s : selectivity) {
+            uint32_t hi = static_cast<uint32_t>(s * 4294967295.0);
+            double ms = time_ms([&] {
+                for (int r = 0; r < reps; ++r) sink += fn(data.data(), data.size(), 0, hi, out.data());
+            });
+            std::cout << std::setw(8) << double(data.size()) * reps / (ms * 1e6);
+        }
+        std::cout << (sink == 42 ? " " : "") << std::endl;
+    }
+
+    /*
+     * The branchy loop is fast only at the extremes, where the branch
+     * predictor guesses right almost every time; near 50% it mispredicts on
+     * about half the elements. The branchless loop costs the same at every
+     * selectivity but is bound by the k -> k dependency and one store per
+     * element. The vector kernels also cost the same at every selectivity
+     * (a table load or compress and one store per 8 or 16 elements), which
+     * is the point for a filter whose selectivity is not known in advance.
+     * The index lists cost the same as the values; a stage that needs several
+     * columns of the survivors computes the index list once and gathers the
+     * columns with it.
+     */
+    return 0;
+}
@@ -0,0 +1,424 @@
+/*
+ * swar_kernels.cpp
+ * ----------------
+ * SIMD within a register: byte kernels on plain 64-bit words, as the
+ * baseline tier under the AVX2 kernels.
+ *
+ * A uint64_t holds 8 bytes. Most byte operations can be done on all 8 at once
+ * with ordinary integer instructions, as long as no carry or borrow crosses
+ * from one byte lane into the next. The usual ways to arrange that:
+ *
+ *   - XOR has no carries at all.
+ *   - Add the low 7 bits of each lane, then fix bit 7 with XOR:
+ *       (a & 0x7F..) + (b & 0x7F..)   cannot carry out of a lane
+ *       ^ ((a ^ b) & 0x80..)          bit 7 of a lane sum, carry ignored
+ *   - A comparison with a constant becomes "add a bias to the low 7 bits and
+ *     look at bit 7": x + (0x80 - k) has bit 7 set exactly when x >= k.
+ *   - A zero byte is found with (v - 0x01..) & ~v & 0x80..: the lowest lane
+ *     flagged is exactly the first zero byte (only lanes above a real zero
+ *     can be flagged by a borrow).
+ *
+ * 1. Kernels: sum_checksum, xor_checksum (checksums.cpp), ASCII case
+ *    conversion (bitwise_and.cpp section 4), byte search and count (zero byte
+ *    or any delimiter).
+ * 2. Dispatch: each public function uses AVX2 when the CPU has it, otherwise
+ *    the SWAR version. SWAR needs nothing beyond 64-bit integer arithmetic,
+ *    so it is also what a generic ARM or non-x86 build runs.
+ * 3. Demo: every tier checked against a byte-at-a-time reference on random
+ *    lengths and alignments, then timed.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+constexpr uint64_t kOnes = 0x0101010101010101ULL; // 0x01 in every lane
+constexpr uint64_t kHigh = 0x8080808080808080ULL; // bit 7 of every lane
+constexpr uint64_t kLow7 = 0x7F7F7F7F7F7F7F7FULL; // bits 0-6 of every lane
+
+// Lane i of the word is byte i of memory on every target.
+inline uint64_t load_le64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+inline void store_le64(uint8_t* p, uint64_t v) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    std::memcpy(p, &v, 8);
+}
+
+// The last len % 8 bytes, zero-padded to a word.
+inline uint64_t load_tail(const uint8_t* p, size_t n) {
+    uint8_t buf[8] = {0};
+    std::memcpy(buf, p, n);
+    return load_le64(buf);
+}
+
+// Byte-lane addition modulo 256, no carries between lanes.
+inline uint64_t add_lanes(uint64_t a, uint64_t b) {
+    return ((a & kLow7) + (b & kLow7)) ^ ((a ^ b) & kHigh);
+}
+
+// Reference (byte at a time)
+// ---------------------------
+uint8_t sum_checksum_bytes(const uint8_t* data, size_t len) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len; ++i) sum += data[i];
+    return static_cast<uint8_t>(sum & 0xFF);
+}
+
+uint8_t xor_checksum_bytes(const uint8_t* data, size_t len) {
+    uint8_t result = 0;
+    for (size_t i = 0; i < len; ++i) result ^= data[i];
+    return result;
+}
+
+void ascii_upper_bytes(uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; ++i)
+        if (data[i] >= 'a' && data[i] <= 'z') data[i] &= 0xDF;
+}
+
+size_t find_byte_bytes(const uint8_t* data, size_t len, uint8_t c) {
+    for (size_t i = 0; i < len; ++i)
+        if (data[i] == c) return i;
+    return len;
+}
+
+size_t count_byte_bytes(const uint8_t* data, size_t len, uint8_t c) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; ++i) n += data[i] == c;
+    return n;
+}
+
+// 1. SWAR kernels
+// ---------------
+// Two independent accumulators, so consecutive words do not wait on each other.
+uint8_t sum_checksum_swar(const uint8_t* data, size_t len) {
+    uint64_t acc0 = 0, acc1 = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        acc0 = add_lanes(acc0, load_le64(data + i));
+        acc1 = add_lanes(acc1, load_le64(data + i + 8));
+    }
+    if (i + 8 <= len) {
+        acc0 = add_lanes(acc0, load_le64(data + i));
+        i += 8;
+    }
+    uint64_t acc = add_lanes(add_lanes(acc0, acc1), load_tail(data + i, len - i));
+    // Fold the 8 lanes into lane 0: 8 -> 4 -> 2 -> 1.
+    acc = add_lanes(acc, acc >> 32);
+    acc = add_lanes(acc, acc >> 16);
+    acc = add_lanes(acc, acc >> 8);
+    return static_cast<uint8_t>(acc);
+}
+
+uint8_t xor_checksum_swar(const uint8_t* data, size_t len) {
+    uint64_t acc = 0;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) acc ^= load_le64(data + i);
+    acc ^= load_tail(data + i, len - i);
+    acc ^= acc >> 32;
+    acc ^= acc >> 16;
+    acc ^= acc >> 8;
+    return static_cast<uint8_t>(acc);
+}
+
+// Bit 7 set in every lane holding 'a'..'z'. Bytes >= 0x80 are excluded by ~v.
+inline uint64_t lowercase_lanes(uint64_t v) {
+    uint64_t low7 = v & kLow7;
+    uint64_t ge_a = low7 + (0x80 - 'a') * kOnes;      // bit 7: byte >= 'a'
+    uint64_t gt_z = low7 + (0x80 - 'z' - 1) * kOnes;  // bit 7: byte >  'z'
+    return ge_a & ~gt_z & ~v & kHigh;
+}
+
+// & 0xDF on lowercase letters: bit 7 of the flag shifted down to bit 5.
+void ascii_upper_swar(uint8_t* data, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v = load_le64(data + i);
+        store_le64(data + i, v ^ (lowercase_lanes(v) >> 2));
+    }
+    if (i < len) {
+        uint64_t v = load_tail(data + i, len - i);
+        uint8_t buf[8];
+        store_le64(buf, v ^ (lowercase_lanes(v) >> 2));
+        std::memcpy(data + i, buf, len - i);
+    }
+}
+
+// Bit 7 set in the first lane equal to zero (lanes above it may be flagged
+// too, by the borrow, but never lanes below).
+inline uint64_t zero_lanes_first(uint64_t v) { return (v - kOnes) & ~v & kHigh; }
+
+// Bit 7 set in exactly the lanes equal to zero: the low 7 bits plus 0x7F
+// carry into bit 7 unless they are all zero, and bit 7 itself is ORed in.
+inline uint64_t zero_lanes_exact(uint64_t v) { return ~(((v & kLow7) + kLow7) | v) & kHigh; }
+
+size_t find_byte_swar(const uint8_t* data, size_t len, uint8_t c) {
+    const uint64_t pattern = c * kOnes;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t hit = zero_lanes_first(load_le64(data + i) ^ pattern);
+        if (hit) return i + __builtin_ctzll(hit) / 8;
+    }
+    for (; i < len; ++i)
+        if (data[i] == c) return i;
+    return len;
+}
+
+// Matches are counted in the byte lanes (0 or 1 per word each), and the lanes
+// are summed every 255 words before any of them can overflow. Baseline
+// x86-64 has no popcnt instruction, so this avoids it.
+size_t count_byte_swar(const uint8_t* data, size_t len, uint8_t c) {
+    const uint64_t pattern = c * kOnes;
+    size_t n = 0, i = 0;
+    while (i + 8 <= len) {
+        uint64_t lanes = 0;
+        size_t end = std::min(len - 7, i + 255 * 8);
+        for (; i < end; i += 8) lanes += zero_lanes_exact(load_le64(data + i) ^ pattern) >> 7;
+        // 8 lanes of <= 255 -> 4 lanes of <= 510 -> one sum in the top 16 bits.
+        lanes = (lanes & 0x00FF00FF00FF00FFULL) + ((lanes >> 8) & 0x00FF00FF00FF00FFULL);
+        n += (lanes * 0x0001000100010001ULL) >> 48;
+    }
+    for (; i < len; ++i) n += data[i] == c;
+    return n;
+}
+
+// AVX2 tier
+// ---------
+#if defined(HAVE_X86_SIMD)
+__attribute__((target("avx2")))
+uint8_t sum_checksum_avx2(const uint8_t* data, size_t len) {
+    // sad_epu8 against zero adds each group of 8 bytes into a 64-bit lane.
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)),
+                                                    _mm256_setzero_si256()));
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    uint64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return static_cast<uint8_t>(sum + sum_checksum_swar(data + i, len - i));
+}
+
+__attribute__((target("avx2")))
+uint8_t xor_checksum_avx2(const uint8_t* data, size_t len) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+        acc = _mm256_xor_si256(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+    uint8_t lanes[32];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return static_cast<uint8_t>(xor_checksum_swar(lanes, 32) ^ xor_checksum_swar(data + i, len - i));
+}
+
+__attribute__((target("avx2")))
+void ascii_upper_avx2(uint8_t* data, size_t len) {
+    const __m256i below_a = _mm256_set1_epi8('a' - 1);
+    const __m256i above_z = _mm256_set1_epi8('z' + 1);
+    const __m256i bit5 = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i is_lower = _mm256_and_si256(_mm256_cmpgt_epi8(v, below_a), _mm256_cmpgt_epi8(above_z, v));
+        v = _mm256_andnot_si256(_mm256_and_si256(is_lower, bit5), v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), v);
+    }
+    ascii_upper_swar(data + i, len - i);
+}
+
+__attribute__((target("avx2")))
+size_t find_byte_avx2(const uint8_t* data, size_t len, uint8_t c) {
+    const __m256i pattern = _mm256_set1_epi8(static_cast<char>(c));
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint32_t hit = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), pattern)));
+        if (hit) return i + __builtin_ctz(hit);
+    }
+    return i + find_byte_swar(data + i, len - i, c);
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t count_byte_avx2(const uint8_t* data, size_t len, uint8_t c) {
+    const __m256i pattern = _mm256_set1_epi8(static_cast<char>(c));
+    size_t n = 0, i = 0;
+    for (; i + 32 <= len; i += 32)
+        n += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), pattern))));
+    return n + count_byte_swar(data + i, len - i, c);
+}
+#endif
+
+// 2. Dispatch
+// -----------
+// Picks the best implementation once, on first use; SWAR is the floor.
+#if defined(HAVE_X86_SIMD)
+static const bool g_use_avx2 = __builtin_cpu_supports("avx2");
+#else
+static const bool g_use_avx2 = false;
+#endif
+
+uint8_t sum_checksum(const uint8_t* data, size_t len) {
+#if defined(HAVE_X86_SIMD)
+    if (g_use_avx2) return sum_checksum_avx2(data, len);
+#endif
+    return sum_checksum_swar(data, len);
+}
+
+uint8_t xor_checksum(const uint8_t* data, size_t len) {
+#if defined(HAVE_X86_SIMD)
+    if (g_use_avx2) return xor_checksum_avx2(data, len);
+#endif
+    return xor_checksum_swar(data, len);
+}
+
+void ascii_upper(uint8_t* data, size_t len) {
+#if defined(HAVE_X86_SIMD)
+    if (g_use_avx2) return ascii_upper_avx2(data, len);
+#endif
+    ascii_upper_swar(data, len);
+}
+
+// Index of the first byte equal to c, or len.
+size_t find_byte(const uint8_t* data, size_t len, uint8_t c) {
+#if defined(HAVE_X86_SIMD)
+    if (g_use_avx2) return find_byte_avx2(data, len, c);
+#endif
+    return find_byte_swar(data, len, c);
+}
+
+size_t count_byte(const uint8_t* data, size_t len, uint8_t c) {
+#if defined(HAVE_X86_SIMD)
+    if (g_use_avx2) return count_byte_avx2(data, len, c);
+#endif
+    return count_byte_swar(data, len, c);
+}
+
+uint8_t sum_checksum(const std::vector<uint8_t>& data) { return sum_checksum(data.data(), data.size()); }
+uint8_t xor_checksum(const std::vector<uint8_t>& data) { return xor_checksum(data.data(), data.size()); }
+
+// 3. Demo
+// -------
+uint64_t next_random(uint64_t& x) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    return x;
+}
+
+template <typename Callback>
+double time_ms(Callback cb) {
+    auto t = std::chrono::steady_clock::now();
+    cb();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+struct Tier {
+    const char* name;
+    uint8_t (*sum)(const uint8_t*, size_t);
+    uint8_t (*xr)(const uint8_t*, size_t);
+    void (*upper)(uint8_t*, size_t);
+    size_t (*find)(const uint8_t*, size_t, uint8_t);
+    size_t (*count)(const uint8_t*, size_t, uint8_t);
+};
+
+int main() {
+    std::vector<Tier> tiers{
+        {"bytes", sum_checksum_bytes, xor_checksum_bytes, ascii_upper_bytes, find_byte_bytes, count_byte_bytes},
+        {"swar", sum_checksum_swar, xor_checksum_swar, ascii_upper_swar, find_byte_swar, count_byte_swar},
+    };
+#if defined(HAVE_X86_SIMD)
+    if (g_use_avx2)
+        tiers.push_back({"avx2", sum_checksum_avx2, xor_checksum_avx2, ascii_upper_avx2, find_byte_avx2, count_byte_avx2});
+#endif
+    std::cout << "Dispatch uses: " << (g_use_avx2 ? "avx2" : "swar") << std::endl;
+
+    // [1] The lane tricks on one word.
+    {
+        const char* text = "Hi,wOrld";
+        uint8_t w[8];
+        std::memcpy(w, text, 8);
+        uint64_t v = load_le64(w);
+        std::cout << "[1] Word \"" << std::string(text, 8) << "\":" << std::hex << std::setfill('0') << std::endl;
+        std::cout << "  lowercase lanes      0x" << std::setw(16) << lowercase_lanes(v) << std::endl;
+        std::cout << "  ',' lanes (exact)    0x" << std::setw(16) << zero_lanes_exact(v ^ (',' * kOnes)) << std::endl;
+        store_le64(w, v ^ (lowercase_lanes(v) >> 2));
+        std::cout << std::dec << std::setfill(' ') << "  upper-cased          \"" << std::string(reinterpret_cast<char*>(w), 8)
+                  << "\"" << std::endl;
+    }
+
+    // [2] Every tier against the byte reference, random lengths and offsets.
+    {
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        std::vector<uint8_t> buf(4096 + 64);
+        size_t errors = 0, cases = 0;
+        for (int round = 0; round < 20000; ++round) {
+            size_t off = next_random(x) % 64, len = next_random(x) % (round < 2000 ? 40 : 4096);
+            int kind = round % 3; // random bytes, text with 0x80+ bytes, sparse delimiters
+            for (uint8_t& b : buf)
+                b = kind == 0 ? static_cast<uint8_t>(next_random(x))
+                  : kind == 1 ? static_cast<uint8_t>(0x20 + next_random(x) % 0x70)
+                              : static_cast<uint8_t>(next_random(x) % 97 == 0 ? '\n' : 'a' + next_random(x) % 26);
+            uint8_t c = kind == 2 ? '\n' : static_cast<uint8_t>(next_random(x));
+            const uint8_t* p = buf.data() + off;
+            std::vector<uint8_t> want(p, p + len);
+            ascii_upper_bytes(want.data(), len);
+            for (const Tier& t : tiers) {
+                std::vector<uint8_t> got(p, p + len);
+                t.upper(got.data(), len);
+                errors += t.sum(p, len) != sum_checksum_bytes(p, len) || t.xr(p, len) != xor_checksum_bytes(p, len) ||
+                          t.find(p, len, c) != find_byte_bytes(p, len, c) ||
+                          t.count(p, len, c) != count_byte_bytes(p, len, c) || got != want;
+                ++cases;
+            }
+        }
+        std::cout << "[2] " << cases << " cases against the byte-at-a-time reference: " << errors << " errors" << std::endl;
+    }
+
+    // [3] Throughput on 64 KiB (stays in L2), GB/s.
+    std::vector<uint8_t> data(64 * 1024);
+    uint64_t x = 0x2545F4914F6CDD1Dull;
+    for (uint8_t& b : data) b = static_cast<uint8_t>(next_random(x) % 100 == 0 ? '\n' : 0x20 + next_random(x) % 0x5F);
+    const int reps = 20000;
+    std::cout << "[3] Throughput, GB/s (64 KiB buffer)" << std::endl;
+    std::cout << "  " << std::left << std::setw(8) << "tier" << std::right << std::setw(9) << "sum" << std::setw(9)
+              << "xor" << std::setw(9) << "upper" << std::setw(9) << "find" << std::setw(9) << "count" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const Tier& t : tiers) {
+        uint64_t sink = 0;
+        auto gbps = [&](auto fn) { return double(data.size()) * reps / (time_ms([&] { for (int r = 0; r < reps; ++r) fn(); }) * 1e6); };
+        double s = gbps([&] { sink += t.sum(data.data(), data.size()); });
+        double xr = gbps([&] { sink += t.xr(data.data(), data.size()); });
+        std::vector<uint8_t> copy = data;
+        double up = gbps([&] { t.upper(copy.data(), copy.size()); sink += copy[sink & 1023]; });
+        double fd = gbps([&] { sink += t.find(data.data(), data.size(), 0); }); // absent: scans everything
+        double ct = gbps([&] { sink += t.count(data.data(), data.size(), '\n'); });
+        std::cout << "  " << std::left << std::setw(8) << t.name << std::right << std::setw(9) << s << std::setw(9)
+                  << xr << std::setw(9) << up << std::setw(9) << fd << std::setw(9) << ct
+                  << (sink == 42 ? " " : "") << std::endl;
+    }
+
+    /*
+     * The byte loops above may be auto-vectorized by the compiler for the
+     * build target (SSE2 is part of baseline x86-64), so on x86 they are not
+     * always as slow as on a generic build; the SWAR versions do not depend
+     * on that and are written so that a generic build still gets 8 bytes per
+     * operation. find_byte returns at the first hit, so for short searches
+     * the cost is dominated by the first word or vector.
+     */
+    return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * tagged_pointer_stack.cpp
+ * ------------------------
+ * Tagged pointers and a lock-free stack / free-list that is safe from the ABA problem.
+ *
+ * The masks of bitwise_and.cpp sections 10-12 work on pointers too, because a
+ * pointer has bits that are always zero:
+ * - High bits: x86-64 and AArch64 user-space addresses fit in 48 bits, so
+ *   bits [63:48] are free for a 16-bit tag.
+ * - Low bits: an object aligned to 64 bytes has address bits [5:0] == 0, so
+ *   they can hold a 6-bit tag.
+ *     pointer = raw & kPtrMask;          // section 10: extract with a mask
+ *     tag     = raw >> 48;               // or raw & ~kPtrMask for low bits
+ *     raw     = pointer | (tag << 48);   // section 12 in reverse: set bits
+ *
+ * The ABA problem. A lock-free stack pops with compare-and-swap:
+ *     old = top;  next = old->next;  CAS(top, old, next)
+ * Between reading 'next' and the CAS another thread may pop 'old', pop 'next'
+ * and push 'old' back. 'top' equals 'old' again ("A-B-A"), the CAS succeeds,
+ * and 'next' -- which is no longer in the stack -- becomes the top.
+ * The fix without a double-width CAS: the tag is a version counter in the
+ * same 64-bit word and every successful update increments it, so the CAS also
+ * compares versions. With 16 tag bits a thread would have to sleep through
+ * exactly 65536 updates for it to wrap; with 6 low bits only 64, so the high
+ * tag is the better choice where the platform allows it.
+ *
+ * Popped nodes are never returned to the operating system, only to the pool's
+ * free list, so a thread that reads old->next of a node just taken by another
+ * thread reads valid (possibly stale) memory, and the tag rejects its CAS.
+ *
+ * 1. TaggedPtr<T, TagBits::High | TagBits::Low>
+ * 2. TreiberStack: intrusive lock-free stack on a tagged top pointer
+ * 3. NodePool: fixed set of frame buffers with a lock-free free list
+ * 4. The ABA scenario step by step, a multithreaded stress test and a
+ *    comparison with a mutex-protected free list
+ */
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+// 1. Tagged pointer
+// -----------------
+enum class TagBits { High, Low };
+
+template <typename T, TagBits Where>
+struct TaggedPtr {
+    static constexpr unsigned kAddressBits = 48;
+    static constexpr unsigned kLowBits = static_cast<unsigned>(__builtin_ctzll(alignof(T)));
+    static constexpr unsigned kTagBits = Where == TagBits::High ? 64 - kAddressBits : kLowBits;
+    static constexpr uint64_t kTagMask = (uint64_t(1) << kTagBits) - 1;
+    static constexpr uint64_t kPtrMask = Where == TagBits::High ? (uint64_t(1) << kAddressBits) - 1 : ~kTagMask;
+    static_assert(kTagBits > 0, "low-bit tags need an over-aligned type");
+
+    uint64_t raw;
+
+    static TaggedPtr make(T* p, uint64_t tag) {
+        uint64_t addr = reinterpret_cast<uintptr_t>(p);
+        if (addr & ~kPtrMask) std::abort(); // address uses the tag bits: tagging impossible
+        tag &= kTagMask;                    // the version counter wraps around
+        return {Where == TagBits::High ? addr | (tag << kAddressBits) : addr | tag};
+    }
+
+    T* ptr() const { return reinterpret_cast<T*>(raw & kPtrMask); }
+    uint64_t tag() const { return Where == TagBits::High ? raw >> kAddressBits : raw & kTagMask; }
+
+    // Same slot, new pointer, next version.
+    TaggedPtr successor(T* p) const { return make(p, tag() + 1); }
+};
+
+// 2. Treiber stack
+// ----------------
+// Node must have a member 'std::atomic<Node*> next'. The stack does not own
+// the nodes and never frees them.
+template <typename Node, TagBits Where = TagBits::High>
+class TreiberStack {
+public:
+    using Tagged = TaggedPtr<Node, Where>;
+
+    TreiberStack() : top_(Tagged::make(nullptr, 0).raw) {}
+
+    void push(Node* n) {
+        uint64_t old = top_.load(std::memory_order_relaxed);
+        do {
+            n->next.store(Tagged{old}.ptr(), std::memory_order_relaxed);
+        } while (!top_.compare_exchange_weak(old, Tagged{old}.successor(n).raw,
+                                             std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    Node* pop() {
+        uint64_t old = top_.load(std::memory_order_acquire);
+        for (;;) {
+            Node* n = Tagged{old}.ptr();
+            if (!n) return nullptr;
+            // May read a node that another thread has just popped; the value is
+            // then stale, and the version check in the CAS below fails.
+            Node* next = n->next.load(std::memory_order_relaxed);
+            if (top_.compare_exchange_weak(old, Tagged{old}.successor(next).raw,
+                                           std::memory_order_acquire, std::memory_order_acquire))
+                return n;
+        }
+    }
+
+    bool empty() const { return Tagged{top_.load(std::memory_order_acquire)}.ptr() == nullptr; }
+    uint64_t version() const { return Tagged{top_.load(std::memory_order_relaxed)}.tag(); }
+
+private:
+    std::atomic<uint64_t> top_;
+};
+
+// 3. Pool of frame buffers with a lock-free free list
+// ---------------------------------------------------
+template <size_t Bytes>
+struct alignas(64) FrameNode {
+    std::atomic<FrameNode*> next{nullptr};
+    uint8_t data[Bytes];
+};
+
+template <typename Node, TagBits Where = TagBits::High>
+class NodePool {
+public:
+    explicit NodePool(size_t count) : nodes_(new Node[count]), count_(count) {
+        for (size_t i = count; i-- > 0;) free_.push(&nodes_[i]);
+    }
+
+    Node* allocate() { return free_.pop(); } // nullptr when exhausted
+    void deallocate(Node* n) { free_.push(n); }
+
+    size_t index(const Node* n) const { return static_cast<size_t>(n - nodes_.get()); }
+    size_t capacity() const { return count_; }
+
+private:
+    std::unique_ptr<Node[]> nodes_;
+    size_t count_;
+    TreiberStack<Node, Where> free_;
+};
+
+// Baseline: the same free list behind a mutex.
+template <typename Node>
+class MutexPool {
+public:
+    explicit MutexPool(size_t count) : nodes_(new Node[count]) {
+        for (size_t i = count; i-- > 0;) free_.push_back(&nodes_[i]);
+    }
+    Node* allocate() {
+        std::lock_guard<std::mutex> lock(m_);
+        if (free_.empty()) return nullptr;
+        Node* n = free_.back();
+        free_.pop_back();
+        return n;
+    }
+    void deallocate(Node* n) {
+        std::lock_guard<std::mutex> lock(m_);
+        free_.push_back(n);
+    }
+
+private:
+    std::mutex m_;
+    std::unique_ptr<Node[]> nodes_;
+    std::vector<Node*> free_;
+};
+
+// 4. Demonstrations
+// -----------------
+using Frame = FrameNode<1472>;
+
+// Each thread takes a few frames, checks that nobody else holds them, and
+// gives them back. Returns the number of double allocations (must be 0) and
+// the throughput in million allocate+deallocate pairs per second.
+template <typename Pool>
+std::pair<uint64_t, double> stress(Pool& pool, size_t capacity, int threads, long rounds,
+                                   const std::function<size_t(Frame*)>& index_of) {
+    std::vector<std::atomic<uint8_t>> owned(capacity);
+    for (auto& o : owned) o.store(0);
+    std::atomic<uint64_t> doubles{0};
+    std::atomic<int> ready{0};
+    std::vector<std::thread> workers;
+    auto t = std::chrono::steady_clock::now();
+    for (int w = 0; w < threads; ++w) {
+        workers.emplace_back([&] {
+            ready.fetch_add(1);
+            while (ready.load() < threads) std::this_thread::yield();
+            Frame* held[4];
+            for (long r = 0; r < rounds; ++r) {
+                int n = 0;
+                for (; n < 4; ++n) {
+                    held[n] = pool.allocate();
+                    if (!held[n]) break;
+                    if (owned[index_of(held[n])].exchange(1)) doubles.fetch_add(1);
+                    held[n]->data[0] = static_cast<uint8_t>(r); // use the buffer
+                }
+                while (n-- > 0) {
+                    owned[index_of(held[n])].store(0);
+                    pool.deallocate(held[n]);
+                }
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+    return {doubles.load(), threads * rounds * 4.0 / s / 1e6};
+}
+
+struct DemoNode {
+    std::atomic<DemoNode*> next{nullptr};
+    char name;
+};
+
+int main() {
+    // [1] Packing and unpacking.
+    Frame* f = new Frame;
+    auto hi = TaggedPtr<Frame, TagBits::High>::make(f, 0xBEEF);
+    auto lo = TaggedPtr<Frame, TagBits::Low>::make(f, 0x2A);
+    std::cout << "[1] Frame at " << f << std::hex << std::endl
+              << "  high tag: raw 0x" << hi.raw << " -> ptr " << hi.ptr() << ", tag 0x" << hi.tag()
+              << " (" << std::dec << hi.kTagBits << " bits)" << std::hex << std::endl
+              << "  low tag:  raw 0x" << lo.raw << " -> ptr " << lo.ptr() << ", tag 0x" << lo.tag()
+              << " (" << std::dec << lo.kTagBits << " bits, alignof = " << alignof(Frame) << ")" << std::endl;
+    auto wrapped = TaggedPtr<Frame, TagBits::Low>::make(f, 63).successor(f);
+    std::cout << "  low tag 63 + 1 wraps to " << wrapped.tag() << std::endl << std::endl;
+    delete f;
+
+    // [2] The ABA interleaving, replayed in one thread. Stack: A -> B -> C.
+    DemoNode a, b, c;
+    a.name = 'A'; b.name = 'B'; c.name = 'C';
+    {
+        // Without a tag: top is a plain pointer.
+        std::atomic<DemoNode*> top{&a};
+        a.next = &b; b.next = &c;
+        DemoNode* seen = top.load();            // thread 1 starts pop(): sees A ...
+        DemoNode* seen_next = seen->next.load(); // ... and A->next == B
+        top = &c;                                // thread 2: pop A, pop B (B is now in use!)
+        a.next = &c; top = &a;                   // thread 2: push A back: A -> C
+        bool ok = top.compare_exchange_strong(seen, seen_next); // thread 1 resumes
+        std::cout << "[2] Plain pointer CAS " << (ok ? "succeeded" : "failed") << ", top is now "
+                  << top.load()->name << (top.load() == &b ? " -- but B was popped by thread 2 (ABA)" : "") << std::endl;
+    }
+    {
+        // With a tag: the same steps on a tagged top, as TreiberStack does them.
+        using T = TaggedPtr<DemoNode, TagBits::High>;
+        std::atomic<uint64_t> top{T::make(&a, 0).raw};
+        a.next = &b; b.next = &c;
+        uint64_t seen = top.load();                            // thread 1: A, version 0
+        DemoNode* seen_next = T{seen}.ptr()->next.load();      // B
+        top = T{top.load()}.successor(&b).raw;                 // thread 2: pop A
+        top = T{top.load()}.successor(&c).raw;                 // thread 2: pop B
+        a.next = &c; top = T{top.load()}.successor(&a).raw;   // thread 2: push A back
+        uint64_t expected = seen;
+        bool ok = top.compare_exchange_strong(expected, T{seen}.successor(seen_next).raw);
+        std::cout << "    Tagged CAS " << (ok ? "succeeded" : "failed") << ": top is " << T{top.load()}.ptr()->name
+                  << " again, but version " << T{top.load()}.tag() << " != " << T{seen}.tag()
+                  << ", so thread 1 reloads and retries" << std::endl;
+    }
+    std::cout << std::endl;
+
+    // [3] Stress test and throughput.
+    const int threads = std::max(4u, std::thread::hardware_concurrency());
+    const size_t capacity = 64;
+    const long rounds = 200000;
+    std::cout << "[3] " << threads << " threads, " << capacity << " frames, 4 allocations per round" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    {
+        NodePool<Frame, TagBits::High> pool(capacity);
+        auto r = stress(pool, capacity, threads, rounds, [&](Frame* n) { return pool.index(n); });
+        std::cout << "  lock-free, 16-bit high tag: " << r.first << " double allocations, " << r.second << " M/s" << std::endl;
+    }
+    {
+        NodePool<Frame, TagBits::Low> pool(capacity);
+        auto r = stress(pool, capacity, threads, rounds, [&](Frame* n) { return pool.index(n); });
+        std::cout << "  lock-free, 6-bit low tag:   " << r.first << " double allocations, " << r.second << " M/s" << std::endl;
+    }
+    {
+        MutexPool<Frame> pool(capacity);
+        std::vector<Frame*> seen;
+        // Index by address: allocate everything once to learn the base.
+        for (size_t i = 0; i < capacity; ++i) seen.push_back(pool.allocate());
+        Frame* base = *std::min_element(seen.begin(), seen.end());
+        for (Frame* n : seen) pool.deallocate(n);
+        auto r = stress(pool, capacity, threads, rounds, [&](Frame* n) { return static_cast<size_t>(n - base); });
+        std::cout << "  mutex:                      " << r.first << " double allocations, " << r.second << " M/s" << std::endl;
+    }
+
+    /*
+     * Without the tag the stress test would eventually hand the same frame to
+     * two threads. The 6-bit low tag only fails if a thread is preempted inside
+     * pop() while a multiple of 64 updates happen -- rare, but not impossible,
+     * which is why the 16-bit high tag is the default.
+     */
+    return 0;
+}
@@ -0,0 +1,388 @@
+/*
+ * udp_batch_sender.cpp
+ * --------------------
+ * The transmit side of udp_batch_receiver.cpp: sending many small
+ * CRC-8-protected frames with few system calls.
+ *
+ * The naive sender builds one frame, appends crc8_checksum(frame) and calls
+ * sendto(): one system call per frame. Here:
+ *
+ * 1. FrameArena: frames are built back to back in one preallocated buffer;
+ *    append() only hands out the next few bytes, nothing is allocated per frame.
+ * 2. stamp(): all frames of the batch get their CRC-8 in one pass, eight
+ *    frames interleaved (see crc8_multi in udp_batch_receiver.cpp).
+ * 3. flush() stamps whatever stamp() has not covered yet and sends it, three ways:
+ *    - PerFrame:  one send() per frame (the baseline);
+ *    - Sendmmsg:  one mmsghdr per frame, up to 1024 frames per sendmmsg();
+ *    - Gso:       UDP generic segmentation offload. Consecutive frames of the
+ *                 same size are already contiguous in the arena, so up to 64 of
+ *                 them go out as ONE datagram-sized message with a UDP_SEGMENT
+ *                 control message; the kernel (or NIC) cuts it into datagrams.
+ *                 Those messages are again batched with sendmmsg().
+ *    GSO needs Linux 4.18+; without it flush() falls back to Sendmmsg.
+ * 4. A loopback benchmark that counts system calls per frame and checks on
+ *    the receiving side that every delivered frame has a valid CRC.
+ */
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+// Table-driven crc8_checksum (polynomial 0x07, initial value 0).
+struct Crc8Table {
+    uint8_t t[256];
+    Crc8Table() {
+        for (int n = 0; n < 256; ++n) {
+            uint8_t c = static_cast<uint8_t>(n);
+            for (int i = 0; i < 8; ++i) c = (c & 0x80) ? (c << 1) ^ 0x07 : c << 1;
+            t[n] = c;
+        }
+    }
+};
+static const Crc8Table kCrc8;
+
+uint8_t crc8_checksum(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; ++i) crc = kCrc8.t[crc ^ data[i]];
+    return crc;
+}
+
+// 1 + 2. Frame arena
+// ------------------
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity_bytes) : buf_(capacity_bytes) {}
+
+    // Reserves a frame with 'payload' bytes (+1 for the CRC) and returns a pointer
+    // to the payload, or nullptr when the arena is full and must be flushed.
+    uint8_t* append(size_t payload) {
+        if (used_ + payload + 1 > buf_.size()) return nullptr;
+        offsets_.push_back(static_cast<uint32_t>(used_));
+        lengths_.push_back(static_cast<uint32_t>(payload + 1));
+        uint8_t* p = buf_.data() + used_;
+        used_ += payload + 1;
+        return p;
+    }
+
+    // Writes the CRC-8 trailer of every frame appended since the last stamp().
+    void stamp() {
+        size_t i = stamped_, n = offsets_.size();
+        for (; i + 8 <= n; i += 8) {
+            const uint8_t* b[8];
+            size_t common = SIZE_MAX;
+            for (int k = 0; k < 8; ++k) {
+                b[k] = buf_.data() + offsets_[i + k];
+                common = std::min<size_t>(common, lengths_[i + k] - 1);
+            }
+            uint8_t c[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+            for (size_t j = 0; j < common; ++j)
+                for (int k = 0; k < 8; ++k) c[k] = kCrc8.t[c[k] ^ b[k][j]]; // 8 independent chains
+            for (int k = 0; k < 8; ++k) {
+                size_t len = lengths_[i + k] - 1;
+                for (size_t j = common; j < len; ++j) c[k] = kCrc8.t[c[k] ^ b[k][j]];
+                buf_[offsets_[i + k] + len] = c[k];
+            }
+        }
+        for (; i < n; ++i) {
+            size_t len = lengths_[i] - 1;
+            buf_[offsets_[i] + len] = crc8_checksum(buf_.data() + offsets_[i], len);
+        }
+        stamped_ = n;
+    }
+
+    size_t frames() const { return offsets_.size(); }
+    const uint8_t* frame(size_t i) const { return buf_.data() + offsets_[i]; }
+    size_t frame_size(size_t i) const { return lengths_[i]; }
+    void clear() { used_ = stamped_ = 0; offsets_.clear(); lengths_.clear(); }
+
+private:
+    std::vector<uint8_t> buf_;
+    std::vector<uint32_t> offsets_, lengths_;
+    size_t used_ = 0, stamped_ = 0;
+};
+
+// 3. Batched sender
+// -----------------
+enum class SendMode { PerFrame, Sendmmsg, Gso };
+
+class BatchSender {
+public:
+    static const size_t kMaxMessages = 1024;     // UIO_MAXIOV: the sendmmsg() limit
+    static const size_t kMaxSegments = 64;       // UDP_MAX_SEGMENTS
+    static const size_t kMaxGsoBytes = 65507;    // one UDP datagram
+
+    BatchSender(int connected_fd, SendMode mode) : fd_(connected_fd), mode_(mode) {
+        if (mode_ == SendMode::Gso && !gso_supported(fd_)) mode_ = SendMode::Sendmmsg;
+        msgs_.resize(kMaxMessages);
+        iov_.resize(kMaxMessages);
+        cmsg_.resize(kMaxMessages);
+        segments_.resize(kMaxMessages);
+    }
+
+    static bool gso_supported(int fd) {
+        int v = 0;
+        socklen_t len = sizeof(v);
+        return getsockopt(fd, SOL_UDP, UDP_SEGMENT, &v, &len) == 0;
+    }
+
+    SendMode mode() const { return mode_; }
+    uint64_t syscalls() const { return syscalls_; }
+    // Frames lost to send errors other than a full transmit queue, over all flushes.
+    uint64_t unsent() const { return unsent_; }
+
+    // Stamps the frames not stamped yet, sends every frame of the arena and
+    // clears it. Returns the number of frames that could not be sent.
+    size_t flush(FrameArena& arena) {
+        arena.stamp();
+        size_t n = arena.frames();
+        uint64_t unsent_before = unsent_;
+        if (mode_ == SendMode::PerFrame) {
+            for (size_t i = 0; i < n; ++i) {
+                ssize_t r;
+                while ((r = send(fd_, arena.frame(i), arena.frame_size(i), 0)) < 0 && retry()) {}
+                ++syscalls_;
+                if (r < 0) ++unsent_;
+            }
+        } else {
+            size_t count = 0;
+            for (size_t i = 0; i < n;) {
+                size_t segments = 1, bytes = arena.frame_size(i);
+                if (mode_ == SendMode::Gso) {
+                    // Equal-sized neighbours are contiguous: extend the message over
+                    // them. A shorter frame may end the group (allowed by UDP GSO).
+                    size_t seg = arena.frame_size(i);
+                    while (i + segments < n && segments < kMaxSegments) {
+                        size_t next = arena.frame_size(i + segments);
+                        if (next > seg || bytes + next > kMaxGsoBytes) break;
+                        bytes += next;
+                        ++segments;
+                        if (next < seg) break;
+                    }
+                }
+                prepare(count, arena.frame(i), bytes, segments > 1 ? arena.frame_size(i) : 0);
+                segments_[count] = static_cast<uint32_t>(segments);
+                i += segments;
+                if (++count == kMaxMessages) {
+                    send_all(count);
+                    count = 0;
+                }
+            }
+            send_all(count);
+        }
+        arena.clear();
+        return static_cast<size_t>(unsent_ - unsent_before);
+    }
+
+private:
+    struct GsoControl {
+        alignas(cmsghdr) char buf[CMSG_SPACE(sizeof(uint16_t))];
+    };
+
+    void prepare(size_t k, const uint8_t* data, size_t bytes, size_t segment_size) {
+        std::memset(&msgs_[k], 0, sizeof(msgs_[k]));
+        iov_[k].iov_base = const_cast<uint8_t*>(data);
+        iov_[k].iov_len = bytes;
+        msgs_[k].msg_hdr.msg_iov = &iov_[k];
+        msgs_[k].msg_hdr.msg_iovlen = 1;
+        if (segment_size) {
+            msgs_[k].msg_hdr.msg_control = cmsg_[k].buf;
+            msgs_[k].msg_hdr.msg_controllen = sizeof(cmsg_[k].buf);
+            cmsghdr* c = CMSG_FIRSTHDR(&msgs_[k].msg_hdr);
+            c->cmsg_level = SOL_UDP;
+            c->cmsg_type = UDP_SEGMENT;
+            c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t gso = static_cast<uint16_t>(segment_size);
+            std::memcpy(CMSG_DATA(c), &gso, sizeof(gso));
+        }
+    }
+
+    // On a hard error the message at 'sent' is the one that failed: count
+    // its frames as unsent, skip it and go on with the rest.
+    void send_all(size_t count) {
+        for (size_t sent = 0; sent < count;) {
+            int r = sendmmsg(fd_, &msgs_[sent], static_cast<unsigned>(count - sent), 0);
+            ++syscalls_;
+            if (r < 0) {
+                if (retry()) continue;
+                unsent_ += segments_[sent++];
+                continue;
+            }
+            sent += static_cast<size_t>(r);
+        }
+    }
+
+    // Loopback can report a full transmit queue; back off and try again.
+    static bool retry() {
+        if (errno != ENOBUFS && errno != EAGAIN) return false;
+        std::this_thread::yield();
+        return true;
+    }
+
+    int fd_;
+    SendMode mode_;
+    uint64_t syscalls_ = 0;
+    uint64_t unsent_ = 0;
+    std::vector<mmsghdr> msgs_;
+    std::vector<iovec> iov_;
+    std::vector<GsoControl> cmsg_;
+    std::vector<uint32_t> segments_; // frames carried by each message
+};
+
+// 4. Loopback benchmark
+// ---------------------
+struct Sink {
+    int fd;
+    uint16_t port;
+    std::atomic<uint64_t> received{0}, valid{0};
+    std::thread th;
+
+    Sink() {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        int rcvbuf = 32 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        timeval tv{0, 200000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+        port = ntohs(addr.sin_port);
+        th = std::thread([this] { run(); });
+    }
+
+    // Receives until the socket stays quiet for the receive timeout.
+    void run() {
+        const size_t batch = 64;
+        std::vector<uint8_t> bufs(batch * 2048);
+        mmsghdr msgs[batch];
+        iovec iov[batch];
+        for (size_t k = 0; k < batch; ++k) {
+            iov[k] = {&bufs[k * 2048], 2048};
+            std::memset(&msgs[k], 0, sizeof(msgs[k]));
+            msgs[k].msg_hdr.msg_iov = &iov[k];
+            msgs[k].msg_hdr.msg_iovlen = 1;
+        }
+        for (;;) {
+            int n = recvmmsg(fd, msgs, batch, MSG_WAITFORONE, nullptr);
+            if (n <= 0) break;
+            uint64_t ok = 0;
+            for (int k = 0; k < n; ++k) {
+                const uint8_t* f = &bufs[k * 2048];
+                size_t len = msgs[k].msg_len;
+                ok += len > 0 && crc8_checksum(f, len - 1) == f[len - 1];
+            }
+            received += static_cast<uint64_t>(n);
+            valid += ok;
+        }
+    }
+
+    // Waits for the receive timeout after the last datagram.
+    void finish() {
+        th.join();
+        close(fd);
+    }
+};
+
+int connect_to(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int sndbuf = 8 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    dst.sin_port = htons(port);
+    connect(fd, reinterpret_cast<sockaddr*>(&dst), sizeof(dst));
+    return fd;
+}
+
+const char* mode_name(SendMode m) {
+    switch (m) {
+    case SendMode::PerFrame: return "send per frame";
+    case SendMode::Sendmmsg: return "sendmmsg";
+    default: return "sendmmsg + UDP GSO";
+    }
+}
+
+double bench(SendMode requested, uint32_t frames, size_t payload, double baseline_syscalls) {
+    Sink sink;
+    int fd = connect_to(sink.port);
+    BatchSender sender(fd, requested);
+    FrameArena arena(1 << 20);
+    auto t = std::chrono::steady_clock::now();
+    for (uint32_t seq = 0; seq < frames; ++seq) {
+        uint8_t* f = arena.append(payload);
+        if (!f) { // arena full: stamp and send everything built so far
+            sender.flush(arena);
+            f = arena.append(payload);
+        }
+        std::memcpy(f, &seq, 4);
+        for (size_t j = 4; j < payload; ++j) f[j] = static_cast<uint8_t>(seq ^ j);
+    }
+    sender.flush(arena);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+    close(fd);
+    sink.finish();
+
+    double per_frame = static_cast<double>(sender.syscalls()) / frames;
+    std::cout << "  " << std::left << std::setw(20) << mode_name(sender.mode()) << std::right << std::fixed
+              << std::setprecision(2) << frames / secs / 1e6 << " Mframes/s, " << std::setprecision(5)
+              << per_frame << " syscalls/frame";
+    if (baseline_syscalls > 0) std::cout << " (" << std::setprecision(0) << baseline_syscalls / per_frame << "x fewer)";
+    std::cout << ", delivered " << sink.received << " (valid CRC " << sink.valid << ")";
+    if (sender.unsent()) std::cout << ", ERROR: " << sender.unsent() << " frames not sent";
+    std::cout << std::endl;
+    return per_frame;
+}
+
+int main() {
+    // The arena stamps exactly what crc8_checksum would compute, for any sizes.
+    FrameArena arena(4096);
+    for (size_t i = 0; i < 29; ++i) {
+        size_t len = 1 + (i * 11) % 40;
+        uint8_t* f = arena.append(len);
+        for (size_t j = 0; j < len; ++j) f[j] = static_cast<uint8_t>(i * 5 + j);
+    }
+    arena.stamp();
+    bool ok = true;
+    for (size_t i = 0; i < arena.frames(); ++i)
+        ok &= arena.frame(i)[arena.frame_size(i) - 1] == crc8_checksum(arena.frame(i), arena.frame_size(i) - 1);
+    std::cout << "[1] Stamped 29 frames of mixed size: " << (ok ? "all CRCs correct" : "WRONG CRC") << std::endl;
+    arena.clear();
+
+    const uint32_t frames = 500000;
+    const size_t payload = 31; // 32-byte frames
+    std::cout << "[2] Loopback, " << frames << " frames of " << payload + 1 << " bytes" << std::endl;
+    double base = bench(SendMode::PerFrame, frames, payload, 0);
+    bench(SendMode::Sendmmsg, frames, payload, base);
+    bench(SendMode::Gso, frames, payload, base);
+
+    /*
+     * sendmmsg removes the per-frame kernel entry; the kernel still walks the
+     * UDP/IP stack once per frame. GSO also removes most of that: one pass
+     * through the stack per 64 frames, segmentation happens at the end.
+     * Loopback drops datagrams when the receiver falls behind, so "delivered"
+     * can be less than sent; every delivered frame must have a valid CRC.
+     */
+    return 0;
+}
@@ -0,0 +1,428 @@
+/*
+ * utf8_validation.cpp
+ * -------------------
+ * Vectorized UTF-8 validation, ASCII case conversion and UTF-8 <-> UTF-16
+ * transcoding.
+ *
+ * The case conversion trick from bitwise_and.cpp section 4 (clear bit 5 with
+ * & 0xDF) is only correct for ASCII letters. Text arriving from the network
+ * must first be proven to be valid UTF-8; after that, every byte below 0x80 is
+ * a real ASCII character (multi-byte UTF-8 sequences only use bytes >= 0x80),
+ * so the ASCII trick can be applied to those bytes in bulk and the rest left
+ * untouched.
+ *
+ * 1. Scalar validator: the reference, decoding one code point at a time.
+ * 2. AVX2 validator: the "lookup" algorithm of Keiser & Lemire (used by
+ *    simdjson/simdutf). Every pair of adjacent bytes is classified with three
+ *    16-entry nibble tables (pshufb); ANDing the results leaves a non-zero bit
+ *    exactly where an error pattern occurs (too short, too long, overlong,
+ *    surrogate, > U+10FFFF). Whole 32-byte ASCII blocks are skipped.
+ * 3. Bulk ASCII case conversion for validated text.
+ * 4. UTF-8 <-> UTF-16 transcoding with vectorized ASCII runs.
+ *
+ * The AVX2 code is compiled with a function-level target attribute and only
+ * chosen at runtime when the CPU supports it, so the program still runs on a
+ * baseline x86-64 machine.
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+// 1. Scalar reference validator
+// -----------------------------
+bool validate_utf8_scalar(const uint8_t* data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        uint8_t b = data[i];
+        if (b < 0x80) { ++i; continue; }
+
+        size_t n;
+        uint32_t cp;
+        if ((b & 0xE0) == 0xC0)      { n = 2; cp = b & 0x1F; }
+        else if ((b & 0xF0) == 0xE0) { n = 3; cp = b & 0x0F; }
+        else if ((b & 0xF8) == 0xF0) { n = 4; cp = b & 0x07; }
+        else return false;                            // stray continuation or 0xF8..0xFF
+        if (i + n > len) return false;                // truncated sequence
+        for (size_t k = 1; k < n; ++k) {
+            if ((data[i + k] & 0xC0) != 0x80) return false;
+            cp = (cp << 6) | (data[i + k] & 0x3F);
+        }
+        if ((n == 2 && cp < 0x80) || (n == 3 && cp < 0x800) || (n == 4 && cp < 0x10000))
+            return false;                             // overlong encoding
+        if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+            return false;                             // out of range or surrogate
+        i += n;
+    }
+    return true;
+}
+
+#if defined(HAVE_X86_SIMD)
+// 2. AVX2 lookup validator
+// ------------------------
+// Error classes, one bit each. A byte pair is invalid when the same bit is set
+// in all three lookups (high nibble of byte 1, low nibble of byte 1, high nibble of byte 2).
+namespace utf8_lookup {
+const uint8_t TOO_SHORT = 1 << 0;      // 11______ 0_______   (lead not followed by continuation)
+const uint8_t TOO_LONG = 1 << 1;       // 0_______ 10______   (continuation without lead)
+const uint8_t OVERLONG_3 = 1 << 2;     // 11100000 100_____
+const uint8_t TOO_LARGE = 1 << 3;      // 11110100 1001____   (> U+10FFFF)
+const uint8_t SURROGATE = 1 << 4;      // 11101101 101_____
+const uint8_t OVERLONG_2 = 1 << 5;     // 1100000_ 10______
+const uint8_t TOO_LARGE_1000 = 1 << 6; // 11110101+ 1000____
+const uint8_t OVERLONG_4 = 1 << 6;     // 11110000 1000____
+const uint8_t TWO_CONTS = 1 << 7;      // 10______ 10______   (may be legal inside a 3/4-byte sequence)
+const uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i lookup16(__m256i nibbles, const uint8_t (&table)[16]) {
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table));
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(t), nibbles);
+}
+
+// The input shifted right by N bytes, with the last N bytes of 'prev' shifted in.
+template <int N>
+__attribute__((target("avx2")))
+static inline __m256i prev_bytes(__m256i input, __m256i prev) {
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i high_nibbles(__m256i v) {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i check_block(__m256i input, __m256i prev_input) {
+    using namespace utf8_lookup;
+    static const uint8_t byte_1_high[16] = {
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, // 0___
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,                                     // 10__
+        TOO_SHORT | OVERLONG_2,                                                         // 1100
+        TOO_SHORT,                                                                      // 1101
+        TOO_SHORT | OVERLONG_3 | SURROGATE,                                             // 1110
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4                             // 1111
+    };
+    static const uint8_t byte_1_low[16] = {
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,                                   // ____0000
+        CARRY | OVERLONG_2,                                                             // ____0001
+        CARRY, CARRY,                                                                   // ____001_
+        CARRY | TOO_LARGE,                                                              // ____0100
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,         // ____0101, 0110
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                                             // ____0111
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,         // ____1000, 1001
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,         // ____1010, 1011
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                                             // ____1100
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,                                 // ____1101
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000          // ____111_
+    };
+    static const uint8_t byte_2_high[16] = {
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, // 0___
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,           // 1000
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,                             // 1001
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,                              // 1010
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,                              // 1011
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT                                              // 11__
+    };
+
+    __m256i prev1 = prev_bytes<1>(input, prev_input);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(lookup16(high_nibbles(prev1), byte_1_high),
+                         lookup16(_mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)), byte_1_low)),
+        lookup16(high_nibbles(input), byte_2_high));
+
+    // Two continuations in a row are fine only as the 3rd/4th byte of a
+    // sequence, i.e. when the byte 2 (3) positions back is a 3-byte (4-byte) lead.
+    __m256i prev2 = prev_bytes<2>(input, prev_input);
+    __m256i prev3 = prev_bytes<3>(input, prev_input);
+    __m256i is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m256i is_fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m256i must_be_cont = _mm256_and_si256(_mm256_or_si256(is_third, is_fourth),
+                                            _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must_be_cont, special);
+}
+
+// Non-zero if the block ends inside a multi-byte sequence that the next block must complete.
+__attribute__((target("avx2")))
+static inline __m256i incomplete_tail(__m256i input) {
+    const __m256i max_value = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(input, max_value);
+}
+
+struct Utf8CheckState {
+    __m256i error;
+    __m256i prev_input;
+    __m256i prev_incomplete;
+};
+
+__attribute__((target("avx2")))
+static inline void check_next_input(Utf8CheckState& s, __m256i input) {
+    if (_mm256_movemask_epi8(input) == 0) {
+        // ASCII fast path: only a sequence left open by the previous block can fail.
+        s.error = _mm256_or_si256(s.error, s.prev_incomplete);
+        s.prev_incomplete = _mm256_setzero_si256();
+    } else {
+        s.error = _mm256_or_si256(s.error, check_block(input, s.prev_input));
+        s.prev_incomplete = incomplete_tail(input);
+    }
+    s.prev_input = input;
+}
+
+__attribute__((target("avx2")))
+bool validate_utf8_avx2(const uint8_t* data, size_t len) {
+    Utf8CheckState s;
+    s.error = s.prev_input = s.prev_incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+        check_next_input(s, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+    if (i < len) {
+        uint8_t tail[32] = {0}; // zero padding is ASCII, so it cannot hide or cause errors
+        std::memcpy(tail, data + i, len - i);
+        check_next_input(s, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail)));
+    }
+    s.error = _mm256_or_si256(s.error, s.prev_incomplete);
+    return _mm256_testz_si256(s.error, s.error);
+}
+#endif
+
+// Picks the best implementation once, on first use.
+bool validate_utf8(const std::vector<uint8_t>& data) {
+#if defined(HAVE_X86_SIMD)
+    static const bool use_avx2 = __builtin_cpu_supports("avx2");
+    if (use_avx2) return validate_utf8_avx2(data.data(), data.size());
+#endif
+    return validate_utf8_scalar(data.data(), data.size());
+}
+
+// 3. Bulk ASCII case conversion
+// -----------------------------
+// 'a'..'z' & 0xDF == 'A'..'Z' (bitwise_and.cpp section 4), applied only where the
+// byte is a lowercase ASCII letter. Bytes >= 0x80 belong to multi-byte UTF-8
+// sequences and are left untouched.
+#if defined(HAVE_X86_SIMD)
+__attribute__((target("avx2")))
+static void ascii_upper_avx2(uint8_t* data, size_t len) {
+    const __m256i below_a = _mm256_set1_epi8('a' - 1);
+    const __m256i above_z = _mm256_set1_epi8('z' + 1);
+    const __m256i bit5 = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        // Signed compares: bytes >= 0x80 are negative and therefore never "lowercase".
+        __m256i is_lower = _mm256_and_si256(_mm256_cmpgt_epi8(v, below_a), _mm256_cmpgt_epi8(above_z, v));
+        v = _mm256_andnot_si256(_mm256_and_si256(is_lower, bit5), v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), v);
+    }
+    for (; i < len; ++i)
+        if (data[i] >= 'a' && data[i] <= 'z') data[i] &= 0xDF;
+}
+#endif
+
+void ascii_upper(uint8_t* data, size_t len) {
+#if defined(HAVE_X86_SIMD)
+    static const bool use_avx2 = __builtin_cpu_supports("avx2");
+    if (use_avx2) return ascii_upper_avx2(data, len);
+#endif
+    for (size_t i = 0; i < len; ++i)
+        if (data[i] >= 'a' && data[i] <= 'z') data[i] &= 0xDF;
+}
+
+// Validate, then upper-case the ASCII letters in place. Returns false (and
+// leaves the payload untouched) if it is not valid UTF-8.
+bool normalize_payload(std::vector<uint8_t>& payload) {
+    if (!validate_utf8(payload)) return false;
+    ascii_upper(payload.data(), payload.size());
+    return true;
+}
+
+// 4. Transcoding
+// --------------
+// UTF-8 -> UTF-16. Runs of 16 ASCII bytes are widened with one instruction;
+// everything else is decoded scalar. Returns false on invalid input.
+bool utf8_to_utf16(const std::vector<uint8_t>& in, std::u16string& out) {
+    if (!validate_utf8(in)) return false;
+    out.resize(in.size()); // never more UTF-16 units than UTF-8 bytes
+    const uint8_t* p = in.data();
+    const uint8_t* end = p + in.size();
+    char16_t* o = &out[0];
+    while (p < end) {
+#if defined(HAVE_X86_SIMD)
+        if (end - p >= 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            if (_mm_movemask_epi8(v) == 0) {
+                __m128i zero = _mm_setzero_si128();
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(o), _mm_unpacklo_epi8(v, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(o + 8), _mm_unpackhi_epi8(v, zero));
+                p += 16;
+                o += 16;
+                continue;
+            }
+        }
+#endif
+        uint8_t b = *p;
+        if (b < 0x80) {
+            *o++ = b;
+            p += 1;
+        } else if (b < 0xE0) {
+            *o++ = static_cast<char16_t>(((b & 0x1F) << 6) | (p[1] & 0x3F));
+            p += 2;
+        } else if (b < 0xF0) {
+            *o++ = static_cast<char16_t>(((b & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F));
+            p += 3;
+        } else {
+            uint32_t cp = ((b & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+            cp -= 0x10000;
+            *o++ = static_cast<char16_t>(0xD800 + (cp >> 10));   // high surrogate
+            *o++ = static_cast<char16_t>(0xDC00 + (cp & 0x3FF)); // low surrogate
+            p += 4;
+        }
+    }
+    out.resize(static_cast<size_t>(o - out.data()));
+    return true;
+}
+
+// UTF-16 -> UTF-8. Runs of 8 ASCII units are narrowed with one pack instruction.
+// Returns false on unpaired surrogates.
+bool utf16_to_utf8(const std::u16string& in, std::vector<uint8_t>& out) {
+    out.resize(in.size() * 3); // worst case: every unit becomes 3 bytes
+    const char16_t* p = in.data();
+    const char16_t* end = p + in.size();
+    uint8_t* o = out.data();
+    while (p < end) {
+#if defined(HAVE_X86_SIMD)
+        if (end - p >= 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            // All eight units < 0x80  <=>  no bit above bit 6 set in any of them.
+            __m128i high = _mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xFF80)));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) == 0xFFFF) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(o), _mm_packus_epi16(v, v));
+                p += 8;
+                o += 8;
+                continue;
+            }
+        }
+#endif
+        uint32_t cp = *p++;
+        if (cp >= 0xD800 && cp <= 0xDFFF) {
+            if (cp > 0xDBFF || p == end || *p < 0xDC00 || *p > 0xDFFF) return false;
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (*p++ - 0xDC00);
+        }
+        if (cp < 0x80) {
+            *o++ = static_cast<uint8_t>(cp);
+        } else if (cp < 0x800) {
+            *o++ = static_cast<uint8_t>(0xC0 | (cp >> 6));
+            *o++ = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            *o++ = static_cast<uint8_t>(0xE0 | (cp >> 12));
+            *o++ = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+            *o++ = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+        } else {
+            *o++ = static_cast<uint8_t>(0xF0 | (cp >> 18));
+            *o++ = static_cast<uint8_t>(0x80 | ((cp >> 12) & 0x3F));
+            *o++ = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+            *o++ = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+        }
+    }
+    out.resize(static_cast<size_t>(o - out.data()));
+    return true;
+}
+
+std::vector<uint8_t> bytes(const std::string& s) { return std::vector<uint8_t>(s.begin(), s.end()); }
+
+double gb_per_s(size_t bytes, std::chrono::steady_clock::time_point start) {
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return bytes / s / 1e9;
+}
+
+int main() {
+    std::cout << "[1] Validation examples" << std::endl;
+    const std::pair<const char*, std::string> samples[] = {
+        {"ASCII", "hello, world"},
+        {"2/3/4-byte sequences", "caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80"},
+        {"overlong '/' (C0 AF)", "a\xC0\xAF"},
+        {"surrogate (ED A0 80)", "x\xED\xA0\x80y"},
+        {"above U+10FFFF (F4 90)", "\xF4\x90\x80\x80"},
+        {"truncated at end", "abc\xE2\x82"},
+        {"stray continuation", "ab\x80" "cd"},
+    };
+    for (const auto& s : samples)
+        std::cout << "  " << std::left << std::setw(24) << s.first << std::right
+                  << (validate_utf8(bytes(s.second)) ? "valid" : "INVALID") << std::endl;
+
+    // Differential test: random mutations of valid text, SIMD vs scalar.
+    std::string base;
+    for (int i = 0; i < 40; ++i) base += "abc \xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80 xyz";
+    uint32_t x = 88172645u;
+    int disagreements = 0;
+    for (int t = 0; t < 20000; ++t) {
+        std::vector<uint8_t> v = bytes(base);
+        for (int m = 0; m < 3; ++m) {
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            v[x % v.size()] = static_cast<uint8_t>(x >> 24);
+        }
+        v.resize(x % v.size());
+        if (validate_utf8(v) != validate_utf8_scalar(v.data(), v.size())) ++disagreements;
+    }
+    std::cout << "  20000 random mutations, SIMD vs scalar disagreements: " << disagreements << std::endl << std::endl;
+
+    std::cout << "[2] Normalization (validate + ASCII upper case)" << std::endl;
+    std::vector<uint8_t> payload = bytes("gr\xC3\xBC\xC3\x9F gott, caf\xC3\xA9!");
+    bool ok = normalize_payload(payload);
+    std::cout << "  " << (ok ? std::string(payload.begin(), payload.end()) : "rejected") << std::endl;
+    std::vector<uint8_t> bad = bytes("bad \xFF input");
+    std::cout << "  'bad \\xFF input' -> " << (normalize_payload(bad) ? "accepted" : "rejected") << std::endl << std::endl;
+
+    std::cout << "[3] Round trip UTF-8 -> UTF-16 -> UTF-8" << std::endl;
+    std::u16string utf16;
+    std::vector<uint8_t> back;
+    std::vector<uint8_t> text = bytes(base);
+    bool round_trip = utf8_to_utf16(text, utf16) && utf16_to_utf8(utf16, back) && back == text;
+    std::cout << "  " << text.size() << " bytes -> " << utf16.size() << " UTF-16 units -> "
+              << back.size() << " bytes: " << (round_trip ? "identical" : "MISMATCH") << std::endl << std::endl;
+
+    std::cout << "[4] Throughput (64 MiB)" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    const size_t size = 64u << 20;
+    std::vector<uint8_t> ascii(size);
+    for (size_t i = 0; i < size; ++i) ascii[i] = static_cast<uint8_t>('a' + i % 26);
+    std::vector<uint8_t> mixed;
+    while (mixed.size() + base.size() <= size) mixed.insert(mixed.end(), base.begin(), base.end());
+
+    auto t = std::chrono::steady_clock::now();
+    bool r1 = validate_utf8_scalar(ascii.data(), ascii.size());
+    std::cout << "  scalar validate, ASCII:  " << gb_per_s(size, t) << " GB/s" << std::endl;
+    t = std::chrono::steady_clock::now();
+    bool r2 = validate_utf8(ascii);
+    std::cout << "  dispatch validate, ASCII: " << gb_per_s(size, t) << " GB/s" << std::endl;
+    t = std::chrono::steady_clock::now();
+    bool r3 = validate_utf8_scalar(mixed.data(), mixed.size());
+    std::cout << "  scalar validate, mixed:  " << gb_per_s(mixed.size(), t) << " GB/s" << std::endl;
+    t = std::chrono::steady_clock::now();
+    bool r4 = validate_utf8(mixed);
+    std::cout << "  dispatch validate, mixed: " << gb_per_s(mixed.size(), t) << " GB/s" << std::endl;
+    t = std::chrono::steady_clock::now();
+    normalize_payload(ascii);
+    std::cout << "  normalize, ASCII:         " << gb_per_s(size, t) << " GB/s" << std::endl;
+    utf8_to_utf16(ascii, utf16); // warm up: first use pays for page faults
+    t = std::chrono::steady_clock::now();
+    utf8_to_utf16(ascii, utf16);
+    std::cout << "  UTF-8 -> UTF-16, ASCII:   " << gb_per_s(size, t) << " GB/s" << std::endl;
+    utf16_to_utf8(utf16, back);
+    t = std::chrono::steady_clock::now();
+    utf16_to_utf8(utf16, back);
+    std::cout << "  UTF-16 -> UTF-8, ASCII:   " << gb_per_s(size, t) << " GB/s" << std::endl;
+    std::cout << "  (results: " << r1 << r2 << r3 << r4 << ")" << std::endl;
+    return 0;
+}